@@ -0,0 +1,167 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: Profiler.h
+// ========
+// Class definition for scoped-zone profiler.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#ifndef __Profiler_h
+#define __Profiler_h
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cg
+{ // begin namespace cg
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Profiler: scoped-zone profiler class
+// ========
+// Zones are timed by ProfileZone objects (see PROFILE_ZONE) and kept
+// in a ring buffer per thread, so that recording takes no lock. When
+// the profiler is disabled, a zone costs a relaxed atomic load.
+class Profiler
+{
+public:
+  /// Timed zone. Times are in nanoseconds since the profiler started.
+  struct Event
+  {
+    const char* name; ///< must outlive the profiler (e.g., a literal)
+    int64_t begin;
+    int64_t end;
+    int depth; ///< number of enclosing zones of the same thread
+
+  }; // Event
+
+  /// Recent events of a thread, in order of their end.
+  struct ThreadEvents
+  {
+    uint32_t id;
+    std::string name;
+    std::vector<Event> events;
+
+  }; // ThreadEvents
+
+  /// Number of events kept per thread.
+  static constexpr int bufferSize = 1 << 16;
+
+  /// Returns true if zones are being recorded.
+  static bool enabled()
+  {
+    return _enabled.load(std::memory_order_relaxed);
+  }
+
+  static void setEnabled(bool enable)
+  {
+    _enabled.store(enable, std::memory_order_relaxed);
+  }
+
+  /// Returns the current time, in nanoseconds since the profiler
+  /// started.
+  static int64_t now();
+
+  /// Names the calling thread in traces.
+  static void setThreadName(const char* name);
+
+  /// Records an event of the calling thread.
+  static void record(const char* name, int64_t begin, int64_t end, int depth);
+
+  /// Copies the events of every thread that ended at or after time
+  /// \c since.
+  static std::vector<ThreadEvents> events(int64_t since = 0);
+
+  /// Discards the recorded events.
+  static void clear();
+
+  /// Writes the recorded events to \c filename in the Chrome trace
+  /// event format, which chrome://tracing and Perfetto can open.
+  static bool writeTrace(const char* filename);
+
+private:
+  static std::atomic<bool> _enabled;
+
+}; // Profiler
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// ProfileZone: profiler zone class
+// ===========
+// Records the time from its construction to its destruction as an
+// event named \c name, if the profiler is enabled when constructed.
+class ProfileZone
+{
+public:
+  explicit ProfileZone(const char* name)
+  {
+    if (Profiler::enabled())
+    {
+      _name = name;
+      _depth = _currentDepth++;
+      _begin = Profiler::now();
+    }
+  }
+
+  ~ProfileZone()
+  {
+    if (_name != nullptr)
+    {
+      --_currentDepth;
+      Profiler::record(_name, _begin, Profiler::now(), _depth);
+    }
+  }
+
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator =(const ProfileZone&) = delete;
+
+private:
+  const char* _name{};
+  int64_t _begin;
+  int _depth;
+
+  static inline thread_local int _currentDepth;
+
+}; // ProfileZone
+
+#define PROFILE_ZONE_NAME(line) profileZone##line
+#define PROFILE_ZONE_LINE(name, line) \
+  cg::ProfileZone PROFILE_ZONE_NAME(line){name}
+
+/// Times the rest of the enclosing block as a zone named \c name.
+#define PROFILE_ZONE(name) PROFILE_ZONE_LINE(name, __LINE__)
+
+/// Times the rest of the enclosing function as a zone named after it.
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+
+} // end namespace cg
+
+#endif // __Profiler_h
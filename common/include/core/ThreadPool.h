@@ -0,0 +1,120 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: ThreadPool.h
+// ========
+// Class definition for thread pool.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#ifndef __ThreadPool_h
+#define __ThreadPool_h
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cg
+{ // begin namespace cg
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// ThreadPool: thread pool class
+// ==========
+class ThreadPool
+{
+public:
+  using Task = std::function<void()>;
+  using IndexFunction = std::function<void(int index, int slot)>;
+
+  /// Constructs a thread pool with \c n worker threads. If \c n is
+  /// zero, one worker per hardware thread (minus the caller) is used.
+  ThreadPool(int n = 0);
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator =(const ThreadPool&) = delete;
+
+  /// Destructor. Waits for all pending tasks.
+  ~ThreadPool();
+
+  /// Returns the number of worker threads.
+  auto size() const
+  {
+    return (int)_workers.size();
+  }
+
+  /// Returns the maximum number of threads (workers plus caller)
+  /// that can run a parallel loop limited to \c n threads.
+  int concurrency(int n = 0) const
+  {
+    auto m = size() + 1;
+    return n <= 0 || n > m ? m : n;
+  }
+
+  /// Enqueues \c task and returns a future for its result.
+  template <typename F>
+  auto submit(F&& task)
+  {
+    using R = decltype(task());
+
+    auto p = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+    auto f = p->get_future();
+
+    enqueue([p]() { (*p)(); });
+    return f;
+  }
+
+  /// Invokes f(i, slot) for every i in [0, count). Indices are taken
+  /// by the calling thread and by at most threads - 1 workers from a
+  /// shared counter; slot in [0, concurrency(threads)) identifies the
+  /// thread running f, so callers can keep per-slot state. Returns
+  /// when every index has been processed. Can be nested.
+  void parallelFor(int count, const IndexFunction& f, int threads = 0);
+
+  /// Returns the process-wide thread pool.
+  static ThreadPool& global();
+
+private:
+  std::vector<std::thread> _workers;
+  std::deque<Task> _tasks;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  bool _stop{false};
+
+  void enqueue(Task&&);
+  void run();
+
+}; // ThreadPool
+
+} // end namespace cg
+
+#endif // __ThreadPool_h
@@ -71,6 +71,9 @@ public:
     transform(m);
   }
 
+  HOST DEVICE
+  Bounds3& operator =(const Bounds3<real>&) = default;
+
   HOST DEVICE
   vec3 center() const
   {
@@ -189,10 +189,23 @@ public:
     return _data.uv != nullptr;
   }
 
+  /// Returns the number of changes of the vertices so far.
+  uint32_t version() const
+  {
+    return _version;
+  }
+
+  /// Marks the vertices as changed. Must be called after editing them.
+  void touch()
+  {
+    ++_version;
+  }
+
   void print(const char* s, FILE* f = stdout) const;
 
 private:
   Data _data;
+  uint32_t _version{};
 
 }; // TriangleMesh
 
@@ -77,10 +77,10 @@ public:
     p.loadShaders(assetFilePath(vs), assetFilePath(fs));
   }
 
-  /// Loads a mesh from an OBJ file.
+  /// Loads a mesh from an OBJ or binary mesh file (see MeshReader).
   static TriangleMesh* loadMesh(const char* filename)
   {
-    return MeshReader::readOBJ(assetFilePath(filename).c_str());
+    return MeshReader::read(assetFilePath(filename).c_str());
   }
 
 private:
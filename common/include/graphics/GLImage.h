@@ -47,6 +47,15 @@ namespace cg
 class GLImage: public Image
 {
 public:
+  struct Region
+  {
+    int x;
+    int y;
+    int w;
+    int h;
+
+  }; // Region
+
   // Constructs an empty image.
   GLImage(int width, int height);
 
@@ -58,6 +67,12 @@ public:
 
   void bind() const;
 
+  // Copies the given regions of buffer, which must have the size of
+  // this image, to the texture through a pixel buffer object.
+  void setData(const ImageBuffer& buffer, const Region* regions, int n);
+
+  using Image::setData;
+
   operator uint32_t() const
   {
     return _handle;
@@ -70,6 +85,7 @@ private:
   class Drawer;
 
   uint32_t _handle;
+  uint32_t _pbo{};
 
   void setSubImage(int, int, int, int, const Pixel*) override;
   void getSubImage(int, int, int, int, Pixel*) const override;
@@ -0,0 +1,136 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: HDRBuffer.h
+// ========
+// Class definition for HDR image buffer.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#ifndef __HDRBuffer_h
+#define __HDRBuffer_h
+
+#include "graphics/Image.h"
+#include <vector>
+
+namespace cg
+{ // begin namespace cg
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// ToneMapping: HDR to 8-bit pixel conversion parameters
+// ===========
+struct ToneMapping
+{
+  enum class Operator
+  {
+    Clamp, // clamps each channel to [0,1]
+    Reinhard, // c / (1 + c)
+    ACES // filmic curve fitted to the ACES reference transform
+  };
+
+  Operator op{Operator::Clamp};
+  float exposure{}; // in stops: colors are scaled by 2^exposure
+  bool sRGB{}; // encodes the result with the sRGB transfer function
+
+}; // ToneMapping
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// HDRBuffer: float RGBA image buffer class
+// =========
+class HDRBuffer
+{
+public:
+  // Default constructor.
+  HDRBuffer() = default;
+
+  // Constructs a buffer filled with black.
+  HDRBuffer(int width, int height);
+
+  auto width() const
+  {
+    return _W;
+  }
+
+  auto height() const
+  {
+    return _H;
+  }
+
+  auto length() const
+  {
+    return _W * _H;
+  }
+
+  const Color* data() const
+  {
+    return _data.data();
+  }
+
+  const Color& operator ()(int x, int y) const
+  {
+#ifdef _DEBUG
+    if (x < 0 || x >= _W || y < 0 || y >= _H)
+      image_index_out_of_range();
+#endif // _DEBUG
+    return _data[size_t(y) * _W + x];
+  }
+
+  Color& operator ()(int x, int y)
+  {
+#ifdef _DEBUG
+    if (x < 0 || x >= _W || y < 0 || y >= _H)
+      image_index_out_of_range();
+#endif // _DEBUG
+    return _data[size_t(y) * _W + x];
+  }
+
+  // Converts the pixels in [x,x+w)x[y,y+h) to the same pixels of out,
+  // which must have the size of this buffer. With HDR_SIMD, the three
+  // channels of a pixel are converted at once
+  void toneMap(ImageBuffer& out,
+    const ToneMapping& toneMapping,
+    int x,
+    int y,
+    int w,
+    int h) const;
+
+  // Converts the whole buffer, in parallel over bands of rows
+  void toneMap(ImageBuffer& out, const ToneMapping& toneMapping) const;
+
+private:
+  int _W{};
+  int _H{};
+  std::vector<Color> _data;
+
+}; // HDRBuffer
+
+} // end namespace cg
+
+#endif // __HDRBuffer_h
@@ -0,0 +1,76 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: MemoryImage.h
+// ========
+// Class definition for image in main memory.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#ifndef __MemoryImage_h
+#define __MemoryImage_h
+
+#include "graphics/Image.h"
+
+namespace cg
+{ // begin namespace cg
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// MemoryImage: image in main memory class
+// ===========
+// Image whose pixels are kept in an ImageBuffer instead of a texture,
+// for rendering without an OpenGL context (e.g., in batch renders).
+class MemoryImage: public Image
+{
+public:
+  // Constructs a black image.
+  MemoryImage(int width, int height);
+
+  // Returns the pixels of this image.
+  const ImageBuffer& buffer() const
+  {
+    return _buffer;
+  }
+
+  // Does nothing: a memory image cannot be drawn.
+  void draw(int, int) const override
+  {
+    // do nothing
+  }
+
+private:
+  ImageBuffer _buffer;
+
+  void setSubImage(int, int, int, int, const Pixel*) override;
+  void getSubImage(int, int, int, int, Pixel*) const override;
+
+}; // MemoryImage
+
+} // end namespace cg
+
+#endif // __MemoryImage_h
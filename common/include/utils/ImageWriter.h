@@ -0,0 +1,66 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: ImageWriter.h
+// ========
+// Class definition for image writer.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#ifndef __ImageWriter_h
+#define __ImageWriter_h
+
+#include "graphics/HDRBuffer.h"
+
+namespace cg
+{ // begin namespace cg
+
+
+//////////////////////////////////////////////////////////
+//
+// ImageWriter: image writer class
+// ===========
+// Image rows are stored bottom-up, as in OpenGL textures, and are
+// written top-down. The functions return false if the file cannot be
+// written.
+class ImageWriter
+{
+public:
+  /// Writes \c image as a binary (P6) PPM file.
+  static bool writePPM(const char* filename, const ImageBuffer& image);
+
+  /// Writes \c image as an 8-bit RGB PNG file (with stored, i.e.,
+  /// uncompressed, deflate blocks).
+  static bool writePNG(const char* filename, const ImageBuffer& image);
+
+  /// Writes \c image as an uncompressed 32-bit float RGB OpenEXR file.
+  static bool writeEXR(const char* filename, const HDRBuffer& image);
+
+}; // ImageWriter
+
+} // end namespace cg
+
+#endif // __ImageWriter_h
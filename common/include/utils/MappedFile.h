@@ -0,0 +1,91 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: MappedFile.h
+// ========
+// Class definition for read-only memory-mapped file.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#ifndef __MappedFile_h
+#define __MappedFile_h
+
+#include <cstddef>
+
+namespace cg
+{ // begin namespace cg
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// MappedFile: read-only memory-mapped file class
+// ==========
+class MappedFile
+{
+public:
+  /// Maps the whole file \c filename into memory for reading. The
+  /// mapping is empty if the file cannot be opened or is empty.
+  MappedFile(const char* filename);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator =(const MappedFile&) = delete;
+
+  /// Destructor. Unmaps the file.
+  ~MappedFile();
+
+  /// Returns true if the file is mapped.
+  bool isOpen() const
+  {
+    return _data != nullptr;
+  }
+
+  /// Returns the address of the first byte of the file.
+  const void* data() const
+  {
+    return _data;
+  }
+
+  /// Returns the size of the file in bytes.
+  size_t size() const
+  {
+    return _size;
+  }
+
+private:
+  const void* _data{};
+  size_t _size{};
+#ifdef _WIN32
+  void* _file;
+  void* _mapping{};
+#else
+  int _file;
+#endif // _WIN32
+
+}; // MappedFile
+
+} // end namespace cg
+
+#endif // __MappedFile_h
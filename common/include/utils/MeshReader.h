@@ -28,7 +28,7 @@
 // Class definition for mesh reader.
 //
 // Author: Paulo Pagliosa
-// Last revision: 15/09/2018
+// Last revision: 17/10/2026
 
 #ifndef __MeshReader_h
 #define __MeshReader_h
@@ -39,6 +39,34 @@ namespace cg
 { // begin namespace cg
 
 
+//////////////////////////////////////////////////////////
+//
+// BinaryMeshHeader: header of a binary mesh file
+// ================
+// The vertex, normal, uv and triangle arrays of a binary mesh file
+// (.mesh) follow the header at the given byte offsets, aligned to
+// binaryMeshAlignment bytes, in the layout of TriangleMesh::Data.
+// The offset of a missing array is 0.
+struct BinaryMeshHeader
+{
+  char magic[4];
+  uint32_t version;
+  int32_t numberOfVertices;
+  int32_t numberOfTriangles;
+  vec3f boundsMin;
+  vec3f boundsMax;
+  uint64_t vertexOffset;
+  uint64_t normalOffset;
+  uint64_t uvOffset;
+  uint64_t triangleOffset;
+
+}; // BinaryMeshHeader
+
+constexpr char binaryMeshMagic[4]{'C', 'G', 'M', 'B'};
+constexpr uint32_t binaryMeshVersion = 1;
+constexpr size_t binaryMeshAlignment = 16;
+
+
 //////////////////////////////////////////////////////////
 //
 // MeshReader: mesh reader class
@@ -46,8 +74,23 @@ namespace cg
 class MeshReader
 {
 public:
+  /// Reads a mesh from a Wavefront OBJ file.
   static TriangleMesh* readOBJ(const char* filename);
 
+  /// Reads a mesh from a binary mesh file. The arrays are copied
+  /// as they are; only missing normals are computed.
+  static TriangleMesh* readBinary(const char* filename);
+
+  /// Reads the header of a binary mesh file into \c header. Returns
+  /// false if the file is not a valid binary mesh file.
+  static bool readBinaryHeader(const char* filename,
+    BinaryMeshHeader& header);
+
+  /// Reads a mesh from a binary or OBJ file. An OBJ file is read from
+  /// its binary version (same name with extension .mesh) if this is
+  /// not older than the OBJ file.
+  static TriangleMesh* read(const char* filename);
+
 }; // MeshReader
 
 } // end namespace cg
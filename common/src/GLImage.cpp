@@ -31,6 +31,7 @@
 // Last revision: 05/06/2019
 
 #include "graphics/GLImage.h"
+#include <cstring>
 #include <memory>
 
 namespace cg
@@ -183,6 +184,7 @@ GLImage::GLImage(int w, int h):
 
 GLImage::~GLImage()
 {
+  glDeleteBuffers(1, &_pbo);
   glDeleteTextures(1, &_handle);
 }
 
@@ -192,6 +194,65 @@ GLImage::bind() const
   glBindTexture(GL_TEXTURE_2D, _handle);
 }
 
+void
+GLImage::setData(const ImageBuffer& buffer, const Region* regions, int n)
+{
+  if (n <= 0)
+    return;
+
+  GLsizeiptr size = 0;
+
+  for (int i = 0; i < n; ++i)
+    size += regions[i].w * regions[i].h * sizeof(Pixel);
+  if (_pbo == 0)
+    glGenBuffers(1, &_pbo);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+  // Orphan the storage of the previous upload, which can be still in
+  // use, instead of waiting for it
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+
+  auto data = (Pixel*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+    0,
+    size,
+    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+  if (data != nullptr)
+  {
+    auto p = data;
+
+    // Pack the rows of the regions one after another
+    for (int i = 0; i < n; ++i)
+    {
+      const auto& r = regions[i];
+
+      for (int y = r.y, e = r.y + r.h; y < e; ++y, p += r.w)
+        memcpy(p, &buffer(r.x, y), r.w * sizeof(Pixel));
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    GLint alignment;
+    GLint texture;
+
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, _handle);
+    size_t offset = 0;
+
+    for (int i = 0; i < n; ++i)
+    {
+      const auto& r = regions[i];
+
+      // With a bound PBO, the data pointer is an offset into it
+      setTextureData(r.x, r.y, r.w, r.h, (const Pixel*)offset);
+      offset += r.w * r.h * sizeof(Pixel);
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
 void
 GLImage::setSubImage(int x, int y, int w, int h, const Pixel* data)
 {
@@ -0,0 +1,206 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: HDRBuffer.cpp
+// ========
+// Source file for HDR image buffer.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#include "graphics/HDRBuffer.h"
+#include "core/ThreadPool.h"
+#include <cmath>
+#if defined(_M_X64) || defined(__SSE2__)
+#define HDR_SIMD
+#include <emmintrin.h>
+#endif // _M_X64 || __SSE2__
+
+namespace cg
+{ // begin namespace cg
+
+namespace internal
+{ // begin namespace internal
+
+constexpr auto sRGBTableSize = 4096;
+
+// 8-bit sRGB encodings of linear values in [0,1]
+static const uint8_t*
+sRGBTable()
+{
+  static uint8_t table[sRGBTableSize];
+  static bool initialized = [] ()
+  {
+    for (int i = 0; i < sRGBTableSize; ++i)
+    {
+      auto x = float(i) / (sRGBTableSize - 1);
+      auto s = x <= 0.0031308f ?
+        12.92f * x :
+        1.055f * std::pow(x, 1 / 2.4f) - 0.055f;
+
+      table[i] = uint8_t(255 * s + 0.5f);
+    }
+    return true;
+  }();
+
+  (void)initialized;
+  return table;
+}
+
+// Clamp only limits c to 1, as the former conversion of the ray
+// tracer did; the other operators map c to [0,1]
+inline float
+toneMapChannel(float c, ToneMapping::Operator op)
+{
+  switch (op)
+  {
+    case ToneMapping::Operator::Reinhard:
+      c = c / (1 + c);
+      break;
+
+    case ToneMapping::Operator::ACES:
+      c = c * (2.51f * c + 0.03f) / (c * (2.43f * c + 0.59f) + 0.14f);
+      break;
+
+    default:
+      return c > 1 ? 1 : c;
+  }
+  return c < 0 ? 0 : (c > 1 ? 1 : c);
+}
+
+} // end namespace internal
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// HDRBuffer implementation
+// =========
+HDRBuffer::HDRBuffer(int w, int h):
+  _W{w},
+  _H{h},
+  _data(size_t(w) * h, Color::black)
+{
+  // do nothing
+}
+
+void
+HDRBuffer::toneMap(ImageBuffer& out,
+  const ToneMapping& toneMapping,
+  int x,
+  int y,
+  int w,
+  int h) const
+{
+  const auto op = toneMapping.op;
+  const auto scale = std::exp2(toneMapping.exposure);
+  const auto table = toneMapping.sRGB ? internal::sRGBTable() : nullptr;
+  // Values in [0,1] are scaled to bytes or to sRGB table indices
+  const auto range = table ? float(internal::sRGBTableSize - 1) : 255.0f;
+  // Negative values are clamped to 0 unless they are converted as
+  // Pixel::set() does, which keeps the output of Clamp unchanged
+  const auto clampZero = table != nullptr ||
+    op != ToneMapping::Operator::Clamp;
+
+  for (int j = y; j < y + h; ++j)
+  {
+    auto src = &_data[size_t(j) * _W + x];
+    auto dst = &out(x, j);
+    int i = 0;
+
+#ifdef HDR_SIMD
+    const auto s = _mm_set1_ps(scale);
+    const auto zero = _mm_setzero_ps();
+    const auto one = _mm_set1_ps(1);
+    const auto r = _mm_set1_ps(range);
+    alignas(16) int32_t v[4];
+
+    // One RGBA pixel per register
+    for (; i < w; ++i)
+    {
+      auto c = _mm_loadu_ps(&src[i].r);
+
+      if (scale != 1)
+        c = _mm_mul_ps(c, s);
+      if (op == ToneMapping::Operator::Reinhard)
+        c = _mm_div_ps(c, _mm_add_ps(one, c));
+      else if (op == ToneMapping::Operator::ACES)
+      {
+        auto n = _mm_mul_ps(c,
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), c), _mm_set1_ps(0.03f)));
+        auto d = _mm_add_ps(_mm_mul_ps(c,
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), c), _mm_set1_ps(0.59f))),
+          _mm_set1_ps(0.14f));
+
+        c = _mm_div_ps(n, d);
+      }
+      if (clampZero)
+        c = _mm_max_ps(c, zero);
+      c = _mm_min_ps(c, one);
+      if (table)
+        c = _mm_add_ps(_mm_mul_ps(c, r), _mm_set1_ps(0.5f));
+      else
+        c = _mm_mul_ps(c, r);
+      // Truncation, as in Pixel::set()
+      _mm_store_si128((__m128i*)v, _mm_cvttps_epi32(c));
+      if (table)
+        dst[i].set(table[v[0]], table[v[1]], table[v[2]]);
+      else
+        dst[i].set(uint8_t(v[0]), uint8_t(v[1]), uint8_t(v[2]));
+    }
+#endif // HDR_SIMD
+    for (; i < w; ++i)
+    {
+      uint8_t rgb[3];
+
+      for (int k = 0; k < 3; ++k)
+      {
+        auto c = internal::toneMapChannel((&src[i].r)[k] * scale, op);
+
+        if (clampZero && c < 0)
+          c = 0;
+        rgb[k] = table ?
+          table[int(c * range + 0.5f)] :
+          uint8_t(int(c * range));
+      }
+      dst[i].set(rgb[0], rgb[1], rgb[2]);
+    }
+  }
+}
+
+void
+HDRBuffer::toneMap(ImageBuffer& out, const ToneMapping& toneMapping) const
+{
+  constexpr auto bandSize = 32;
+  auto n = (_H + bandSize - 1) / bandSize;
+
+  ThreadPool::global().parallelFor(n, [&](int band, int)
+    {
+      auto y = band * bandSize;
+
+      toneMap(out, toneMapping, 0, y, _W, std::min(bandSize, _H - y));
+    });
+}
+
+} // end namespace cg
@@ -0,0 +1,274 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: ImageWriter.cpp
+// ========
+// Source file for image writer.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#include "utils/ImageWriter.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace cg
+{ // begin namespace cg
+
+namespace internal
+{ // begin namespace internal
+
+using Bytes = std::vector<uint8_t>;
+
+static bool
+writeFile(const char* filename, const Bytes& bytes)
+{
+  auto file = std::fopen(filename, "wb");
+
+  if (file == nullptr)
+    return false;
+
+  auto ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+
+  return fclose(file) == 0 && ok;
+}
+
+// Appends the raw bytes of value (little-endian on the supported
+// targets)
+template <typename T>
+inline void
+put(Bytes& bytes, const T& value)
+{
+  auto p = (const uint8_t*)&value;
+
+  bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+inline void
+putBE32(Bytes& bytes, uint32_t value)
+{
+  for (int shift = 24; shift >= 0; shift -= 8)
+    bytes.push_back(uint8_t(value >> shift));
+}
+
+inline void
+putString(Bytes& bytes, const char* s)
+{
+  bytes.insert(bytes.end(), s, s + strlen(s) + 1);
+}
+
+static uint32_t
+crc32(const uint8_t* data, size_t size)
+{
+  static uint32_t table[256];
+  static bool initialized = [] ()
+  {
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      auto c = i;
+
+      for (int k = 0; k < 8; ++k)
+        c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    return true;
+  }();
+  auto c = 0xffffffffu;
+
+  (void)initialized;
+  for (size_t i = 0; i < size; ++i)
+    c = table[(c ^ data[i]) & 0xff] ^ (c >> 8);
+  return c ^ 0xffffffff;
+}
+
+// Appends a PNG chunk of the given type and data
+static void
+putChunk(Bytes& bytes, const char* type, const Bytes& data)
+{
+  putBE32(bytes, uint32_t(data.size()));
+
+  auto start = bytes.size();
+
+  bytes.insert(bytes.end(), type, type + 4);
+  bytes.insert(bytes.end(), data.begin(), data.end());
+  putBE32(bytes, crc32(bytes.data() + start, bytes.size() - start));
+}
+
+} // end namespace internal
+
+
+//////////////////////////////////////////////////////////
+//
+// ImageWriter implementation
+// ===========
+bool
+ImageWriter::writePPM(const char* filename, const ImageBuffer& image)
+{
+  auto w = image.width();
+  auto h = image.height();
+  char header[32];
+  auto n = snprintf(header, sizeof header, "P6\n%d %d\n255\n", w, h);
+  internal::Bytes bytes(header, header + n);
+
+  bytes.reserve(n + size_t(w) * h * 3);
+  for (int y = h - 1; y >= 0; --y)
+  {
+    auto row = (const uint8_t*)&image(0, y);
+
+    bytes.insert(bytes.end(), row, row + size_t(w) * 3);
+  }
+  return internal::writeFile(filename, bytes);
+}
+
+bool
+ImageWriter::writePNG(const char* filename, const ImageBuffer& image)
+{
+  static_assert(sizeof(Pixel) == 3, "Pixel must have 3 bytes");
+
+  using namespace internal;
+
+  const uint8_t signature[]{137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+  auto w = image.width();
+  auto h = image.height();
+  Bytes bytes(signature, signature + sizeof signature);
+  Bytes data;
+
+  // IHDR: 8-bit RGB, no interlacing
+  putBE32(data, w);
+  putBE32(data, h);
+  data.insert(data.end(), {8, 2, 0, 0, 0});
+  putChunk(bytes, "IHDR", data);
+
+  // Scanlines, each one preceded by filter type 0 (none)
+  auto rowSize = size_t(w) * 3 + 1;
+  Bytes raw(rowSize * h);
+
+  for (int y = 0; y < h; ++y)
+  {
+    auto row = &raw[rowSize * y];
+
+    row[0] = 0;
+    memcpy(row + 1, &image(0, h - 1 - y), rowSize - 1);
+  }
+
+  // IDAT: zlib stream of stored deflate blocks
+  constexpr size_t maxBlockSize = 65535;
+  uint32_t a = 1;
+  uint32_t b = 0;
+
+  data.clear();
+  data.push_back(0x78);
+  data.push_back(0x01);
+  for (size_t i = 0; i < raw.size() || i == 0; i += maxBlockSize)
+  {
+    auto size = std::min(raw.size() - i, maxBlockSize);
+    auto last = i + size == raw.size();
+
+    data.push_back(last);
+    put(data, uint16_t(size));
+    put(data, uint16_t(~size));
+    data.insert(data.end(), raw.begin() + i, raw.begin() + i + size);
+  }
+  for (auto c : raw)
+  {
+    a = (a + c) % 65521;
+    b = (b + a) % 65521;
+  }
+  putBE32(data, b << 16 | a);
+  putChunk(bytes, "IDAT", data);
+  putChunk(bytes, "IEND", {});
+  return writeFile(filename, bytes);
+}
+
+bool
+ImageWriter::writeEXR(const char* filename, const HDRBuffer& image)
+{
+  using namespace internal;
+
+  auto w = image.width();
+  auto h = image.height();
+  Bytes bytes;
+  auto attribute = [&bytes](const char* name, const char* type, int size)
+  {
+    putString(bytes, name);
+    putString(bytes, type);
+    put(bytes, size);
+  };
+
+  // Magic number and version 2 (single-part scanline file)
+  put(bytes, 20000630);
+  put(bytes, 2);
+  // Channels, in alphabetical order, with pixel type FLOAT (2)
+  attribute("channels", "chlist", 3 * 18 + 1);
+  for (auto name : {"B", "G", "R"})
+  {
+    putString(bytes, name);
+    put(bytes, 2);
+    put(bytes, 0); // pLinear and reserved
+    put(bytes, 1);
+    put(bytes, 1);
+  }
+  bytes.push_back(0);
+  attribute("compression", "compression", 1);
+  bytes.push_back(0);
+  for (auto name : {"dataWindow", "displayWindow"})
+  {
+    attribute(name, "box2i", 16);
+    put(bytes, 0);
+    put(bytes, 0);
+    put(bytes, w - 1);
+    put(bytes, h - 1);
+  }
+  attribute("lineOrder", "lineOrder", 1);
+  bytes.push_back(0);
+  attribute("pixelAspectRatio", "float", 4);
+  put(bytes, 1.0f);
+  attribute("screenWindowCenter", "v2f", 8);
+  put(bytes, 0.0f);
+  put(bytes, 0.0f);
+  attribute("screenWindowWidth", "float", 4);
+  put(bytes, 1.0f);
+  bytes.push_back(0);
+
+  // Offset table, one scanline per block
+  auto dataSize = 3 * w * (int)sizeof(float);
+  auto offset = uint64_t(bytes.size()) + sizeof(uint64_t) * h;
+
+  for (int y = 0; y < h; ++y, offset += 8 + dataSize)
+    put(bytes, offset);
+  bytes.reserve(size_t(offset));
+  for (int y = 0; y < h; ++y)
+  {
+    put(bytes, y);
+    put(bytes, dataSize);
+    for (int c = 2; c >= 0; --c)
+      for (int x = 0; x < w; ++x)
+        put(bytes, (&image(x, h - 1 - y).r)[c]);
+  }
+  return writeFile(filename, bytes);
+}
+
+} // end namespace cg
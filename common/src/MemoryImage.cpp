@@ -0,0 +1,65 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: MemoryImage.cpp
+// ========
+// Source file for image in main memory.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#include "graphics/MemoryImage.h"
+#include <cstring>
+
+namespace cg
+{ // begin namespace cg
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// MemoryImage implementation
+// ===========
+MemoryImage::MemoryImage(int w, int h):
+  Image{w, h},
+  _buffer{w, h}
+{
+  memset(&_buffer[0], 0, sizeof(Pixel) * _buffer.length());
+}
+
+void
+MemoryImage::setSubImage(int x, int y, int w, int h, const Pixel* data)
+{
+  for (int j = 0; j < h; ++j, data += w)
+    memcpy(&_buffer(x, y + j), data, sizeof(Pixel) * w);
+}
+
+void
+MemoryImage::getSubImage(int x, int y, int w, int h, Pixel* data) const
+{
+  for (int j = 0; j < h; ++j, data += w)
+    memcpy(data, &_buffer(x, y + j), sizeof(Pixel) * w);
+}
+
+} // end namespace cg
@@ -28,10 +28,18 @@
 // Source file for mesh reader.
 //
 // Author: Paulo Pagliosa
-// Last revision: 05/09/2019
+// Last revision: 17/10/2026
 
 #include "utils/MeshReader.h"
+#include "core/Profiler.h"
+#include "core/ThreadPool.h"
+#include "utils/MappedFile.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
 #include <filesystem>
+#include <vector>
 
 namespace cg
 { // begin namespace cg
@@ -39,191 +47,286 @@ namespace cg
 namespace internal
 { // begin namespace internal
 
+using Triangle = TriangleMesh::Triangle;
+
+// Vertices and faces read from a chunk of an OBJ file. Relative
+// (negative) indices are resolved against the vertices of the chunk
+// and the slots holding them are offset when the chunks are merged
+struct OBJChunk
+{
+  const char* begin;
+  const char* end;
+  std::vector<vec3f> vertices;
+  std::vector<Triangle> triangles;
+  std::vector<int> relativeSlots;
+  int errors{};
+
+  OBJChunk(const char* begin, const char* end):
+    begin{begin},
+    end{end}
+  {
+    // do nothing
+  }
+
+}; // OBJChunk
+
+inline bool
+isBlank(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+inline bool
+isEndOfLine(char c)
+{
+  return c == '\n' || c == '\r' || c == '#';
+}
+
+inline const char*
+skipBlanks(const char* s, const char* end)
+{
+  while (s < end && isBlank(*s))
+    ++s;
+  return s;
+}
+
+inline const char*
+nextLine(const char* s, const char* end)
+{
+  auto eol = (const char*)memchr(s, '\n', end - s);
+  return eol != nullptr ? eol + 1 : end;
+}
+
+template <typename T>
+inline const char*
+parseNumber(const char* s, const char* end, T& value, int& errors)
+{
+  s = skipBlanks(s, end);
+  if (s < end && *s == '+')
+    ++s;
+
+  auto r = std::from_chars(s, end, value);
+
+  if (r.ec != std::errc{})
+  {
+    value = 0;
+    errors++;
+  }
+  return r.ptr;
+}
+
 void
-readMeshSize(FILE* file, TriangleMesh::Data& data)
+parseFace(const char* s, const char* end, OBJChunk& chunk)
 {
-  const unsigned int lineSize{128};
-  int nv{};
-  int nt{};
+  auto nv = int(chunk.vertices.size());
+  int first{};
+  int prev{};
+  bool firstRelative{};
+  bool prevRelative{};
+
+  for (int n = 0;; ++n)
+  {
+    s = skipBlanks(s, end);
+    if (s == end || isEndOfLine(*s))
+      break;
+
+    int v;
+    auto r = std::from_chars(s, end, v);
 
-  for (char line[lineSize]; fscanf_s(file, "%s", line, lineSize) != EOF;)
-    switch (line[0])
+    if (r.ec != std::errc{} || v == 0)
     {
-      case 'v':
-        if (line[1] == '\0')
-            nv++;
-        fgets(line, lineSize, file);
-        break;
+      chunk.errors++;
+      return;
+    }
+    // Skip the texture and normal indices, if any
+    for (s = r.ptr; s < end && !isBlank(*s) && !isEndOfLine(*s); ++s)
+      ;
 
-      case 'f':
-      {
-        int v;
-        int n;
-        int t;
-
-        fscanf_s(file, "%s", line, lineSize);
-        /* can be one of %d, %d//%d, %d/%d, %d/%d/%d %d//%d */
-        if (strstr(line, "//"))
-        {
-          /* v//n */
-          sscanf_s(line, "%d//%d", &v, &n);
-          fscanf_s(file, "%d//%d", &v, &n);
-          fscanf_s(file, "%d//%d", &v, &n);
-          nt++;
-          while (fscanf_s(file, "%d//%d", &v, &n) > 0)
-            nt++;
-        }
-        else if (sscanf_s(line, "%d/%d/%d", &v, &t, &n) == 3)
-        {
-          /* v/t/n */
-          fscanf_s(file, "%d/%d/%d", &v, &t, &n);
-          fscanf_s(file, "%d/%d/%d", &v, &t, &n);
-          nt++;
-          while (fscanf_s(file, "%d/%d/%d", &v, &t, &n) > 0)
-            nt++;
-        }
-        else if (sscanf_s(line, "%d/%d", &v, &t) == 2)
-        {
-          /* v/t */
-          fscanf_s(file, "%d/%d", &v, &t);
-          fscanf_s(file, "%d/%d", &v, &t);
-          nt++;
-          while (fscanf_s(file, "%d/%d", &v, &t) > 0)
-            nt++;
-        }
-        else
-        {
-          /* v */
-          fscanf_s(file, "%d", &v);
-          fscanf_s(file, "%d", &v);
-          nt++;
-          while (fscanf_s(file, "%d", &v) > 0)
-            nt++;
-        }
-        break;
-      }
+    auto relative = v < 0;
 
-      default:
-        fgets(line, lineSize, file);
+    v = relative ? nv + v : v - 1;
+    if (n == 0)
+    {
+      first = v;
+      firstRelative = relative;
     }
-  data.numberOfVertices = nv;
-  data.numberOfTriangles = nt;
+    else if (n >= 2)
+    {
+      // Faces with more than three vertices are split into a fan
+      auto slot = int(chunk.triangles.size()) * 3;
+
+      chunk.triangles.push_back({first, prev, v});
+      if (firstRelative)
+        chunk.relativeSlots.push_back(slot);
+      if (prevRelative)
+        chunk.relativeSlots.push_back(slot + 1);
+      if (relative)
+        chunk.relativeSlots.push_back(slot + 2);
+    }
+    prev = v;
+    prevRelative = relative;
+  }
 }
 
 void
-readMeshData(FILE* file, TriangleMesh::Data& data)
+parseChunk(OBJChunk& chunk)
 {
-  const unsigned int lineSize{128};
-  auto vertex = data.vertices;
-  auto triangle = data.triangles;
+  auto end = chunk.end;
 
-  for (char line[lineSize]; fscanf_s(file, "%s", line, lineSize) != EOF;)
-    switch (line[0])
+  for (auto s = chunk.begin; s < end; s = nextLine(s, end))
+  {
+    s = skipBlanks(s, end);
+    if (end - s < 2 || !isBlank(s[1]))
+      continue;
+    if (s[0] == 'v')
     {
-      case 'v':
-      {
-        float x;
-        float y;
-        float z;
-
-        switch (line[1])
-        {
-          case '\0':
-            fscanf_s(file, "%f %f %f", &x, &y, &z);
-            vertex->set(x, y, z);
-            vertex++;
-            break;
+      vec3f p;
 
-          default:
-            fgets(line, lineSize, file);
-        }
-        break;
-      }
+      s = parseNumber(s + 1, end, p.x, chunk.errors);
+      s = parseNumber(s, end, p.y, chunk.errors);
+      s = parseNumber(s, end, p.z, chunk.errors);
+      chunk.vertices.push_back(p);
+    }
+    else if (s[0] == 'f')
+      parseFace(s + 1, end, chunk);
+  }
+}
 
-      case 'f':
-      {
-        int v;
-        int n;
-        int t;
-
-        fscanf_s(file, "%s", line, lineSize);
-        /* Can be one of %d, %d//%d, %d/%d, %d/%d/%d %d//%d */
-        if (strstr(line, "//"))
-        {
-          /* v//n */
-          sscanf_s(line, "%d//%d", &v, &n);
-          triangle->v[0] = v - 1;
-          fscanf_s(file, "%d//%d", &v, &n);
-          triangle->v[1] = v - 1;
-          fscanf_s(file, "%d//%d", &v, &n);
-          triangle->v[2] = v - 1;
-          triangle++;
-          while (fscanf_s(file, "%d//%d", &v, &n) > 0)
-          {
-            triangle->v[0] = triangle[-1].v[0];
-            triangle->v[1] = triangle[-1].v[2];
-            triangle->v[2] = v - 1;
-            triangle++;
-          }
-        }
-        else if (sscanf_s(line, "%d/%d/%d", &v, &t, &n) == 3)
-        {
-          /* v/t/n */
-          triangle->v[0] = v - 1;
-          fscanf_s(file, "%d/%d/%d", &v, &t, &n);
-          triangle->v[1] = v - 1;
-          fscanf_s(file, "%d/%d/%d", &v, &t, &n);
-          triangle->v[2] = v - 1;
-          triangle++;
-          while (fscanf_s(file, "%d/%d/%d", &v, &t, &n) > 0)
-          {
-            triangle->v[0] = triangle[-1].v[0];
-            triangle->v[1] = triangle[-1].v[2];
-            triangle->v[2] = v - 1;
-            triangle++;
-          }
-        }
-        else if (sscanf_s(line, "%d/%d", &v, &t) == 2)
-        {
-          /* v/t */
-          triangle->v[0] = v - 1;
-          fscanf_s(file, "%d/%d", &v, &t);
-          triangle->v[1] = v - 1;
-          fscanf_s(file, "%d/%d", &v, &t);
-          triangle->v[2] = v - 1;
-          triangle++;
-          while (fscanf_s(file, "%d/%d", &v, &t) > 0)
-          {
-            triangle->v[0] = triangle[-1].v[0];
-            triangle->v[1] = triangle[-1].v[2];
-            triangle->v[2] = v - 1;
-            triangle++;
-          }
-        }
-        else
-        {
-          /* v */
-          sscanf_s(line, "%d", &v);
-          triangle->v[0] = v - 1;
-          fscanf_s(file, "%d", &v);
-          triangle->v[1] = v - 1;
-          fscanf_s(file, "%d", &v);
-          triangle->v[2] = v - 1;
-          triangle++;
-          while (fscanf_s(file, "%d", &v) > 0)
+std::vector<OBJChunk>
+splitOBJ(const char* data, size_t size, size_t chunkSize)
+{
+  std::vector<OBJChunk> chunks;
+  auto end = data + size;
+
+  for (auto s = data; s < end;)
+  {
+    auto e = end;
+
+    // Chunks end at line boundaries
+    if (size_t(end - s) > chunkSize)
+      e = nextLine(s + chunkSize, end);
+    chunks.push_back({s, e});
+    s = e;
+  }
+  return chunks;
+}
+
+bool
+mergeOBJ(std::vector<OBJChunk>& chunks, TriangleMesh::Data& data)
+{
+  auto n = int(chunks.size());
+  std::vector<int> vertexBase(n + 1);
+  std::vector<int> triangleBase(n + 1);
+  int errors{};
+
+  for (int i = 0; i < n; ++i)
+  {
+    vertexBase[i + 1] = vertexBase[i] + int(chunks[i].vertices.size());
+    triangleBase[i + 1] = triangleBase[i] + int(chunks[i].triangles.size());
+    errors += chunks[i].errors;
+  }
+  if (errors > 0)
+    fprintf(stderr, "OBJ: %d malformed value(s) or index(es)\n", errors);
+
+  auto nv = vertexBase[n];
+  auto nt = triangleBase[n];
+
+  data.numberOfVertices = nv;
+  data.numberOfTriangles = nt;
+  data.vertices = new vec3f[nv];
+  data.vertexNormals = nullptr;
+  data.triangles = new Triangle[nt];
+
+  std::atomic<int> badTriangles{};
+
+  ThreadPool::global().parallelFor(n, [&](int i, int)
+    {
+      auto& chunk = chunks[i];
+      auto triangles = data.triangles + triangleBase[i];
+      auto base = vertexBase[i];
+      int bad{};
+
+      std::copy(chunk.vertices.begin(),
+        chunk.vertices.end(),
+        data.vertices + base);
+      std::copy(chunk.triangles.begin(), chunk.triangles.end(), triangles);
+      for (auto slot : chunk.relativeSlots)
+        triangles[slot / 3].v[slot % 3] += base;
+      for (size_t t = 0, e = chunk.triangles.size(); t < e; ++t)
+        for (auto v : triangles[t].v)
+          if (v < 0 || v >= nv)
           {
-            triangle->v[0] = triangle[-1].v[0];
-            triangle->v[1] = triangle[-1].v[2];
-            triangle->v[2] = v - 1;
-            triangle++;
+            bad++;
+            break;
           }
-        }
-        break;
-      }
+      badTriangles += bad;
+      // Release the chunk memory as soon as it is merged
+      chunk = {nullptr, nullptr};
+    });
+  if (badTriangles == 0)
+    return true;
+  fprintf(stderr,
+    "OBJ: %d triangle(s) with out of range indices\n",
+    badTriangles.load());
+  delete []data.vertices;
+  delete []data.triangles;
+  return false;
+}
 
-      default:
-        fgets(line, lineSize, file);
-    }
+const BinaryMeshHeader*
+binaryMeshHeader(const MappedFile& file)
+{
+  const auto size = file.size();
+
+  if (size < sizeof(BinaryMeshHeader))
+    return nullptr;
+
+  auto header = (const BinaryMeshHeader*)file.data();
+  const auto nv = header->numberOfVertices;
+  const auto nt = header->numberOfTriangles;
+
+  if (memcmp(header->magic, binaryMeshMagic, sizeof binaryMeshMagic) != 0 ||
+    header->version != binaryMeshVersion ||
+    nv < 0 ||
+    nt < 0)
+    return nullptr;
+
+  static_assert(sizeof(BinaryMeshHeader) == 72,
+    "Unexpected binary mesh header layout");
+
+  auto fits = [size](uint64_t offset, size_t n, size_t elementSize)
+  {
+    if (offset == 0)
+      return n == 0;
+    return offset % binaryMeshAlignment == 0 &&
+      offset >= sizeof(BinaryMeshHeader) &&
+      offset <= size &&
+      (size - offset) / elementSize >= n;
+  };
+
+  if (!fits(header->vertexOffset, nv, sizeof(vec3f)) ||
+    !fits(header->triangleOffset, nt, sizeof(Triangle)))
+    return nullptr;
+  // Normals and uv are optional
+  if (header->normalOffset != 0 &&
+    !fits(header->normalOffset, nv, sizeof(vec3f)))
+    return nullptr;
+  if (header->uvOffset != 0 && !fits(header->uvOffset, nv, sizeof(vec2f)))
+    return nullptr;
+  return header;
+}
+
+template <typename T>
+inline T*
+copyArray(const MappedFile& file, uint64_t offset, int n)
+{
+  if (offset == 0)
+    return nullptr;
+
+  auto a = new T[n];
+
+  memcpy(a, (const char*)file.data() + offset, n * sizeof(T));
+  return a;
 }
 
 } // end namespace internal
@@ -236,22 +339,32 @@ readMeshData(FILE* file, TriangleMesh::Data& data)
 TriangleMesh*
 MeshReader::readOBJ(const char* filename)
 {
-  FILE* file;
+  PROFILE_ZONE("MeshReader::readOBJ");
 
-  fopen_s(&file, filename, "r");
-  if (file == nullptr)
+  MappedFile file{filename};
+
+  if (!file.isOpen())
     return nullptr;
+  printf("Reading Wavefront OBJ file %s...\n", filename);
+
+  // Small files are parsed by a single chunk
+  constexpr size_t minChunkSize{1 << 20};
+  auto& pool = ThreadPool::global();
+  auto chunkSize = std::max(minChunkSize,
+    file.size() / (size_t(pool.concurrency()) * 4));
+  auto chunks = internal::splitOBJ((const char*)file.data(),
+    file.size(),
+    chunkSize);
+
+  pool.parallelFor(int(chunks.size()), [&](int i, int)
+    {
+      internal::parseChunk(chunks[i]);
+    });
 
   TriangleMesh::Data data;
 
-  internal::readMeshSize(file, data);
-  data.vertices = new vec3f[data.numberOfVertices];
-  data.vertexNormals = nullptr;
-  data.triangles = new TriangleMesh::Triangle[data.numberOfTriangles];
-  rewind(file);
-  printf("Reading Wavefront OBJ file %s...\n", filename);
-  internal::readMeshData(file, data);
-  fclose(file);
+  if (!internal::mergeOBJ(chunks, data))
+    return nullptr;
 
   auto mesh = new TriangleMesh{std::move(data)};
 
@@ -259,4 +372,87 @@ MeshReader::readOBJ(const char* filename)
   return mesh;
 }
 
+TriangleMesh*
+MeshReader::readBinary(const char* filename)
+{
+  PROFILE_ZONE("MeshReader::readBinary");
+
+  MappedFile file{filename};
+  auto header = internal::binaryMeshHeader(file);
+
+  if (header == nullptr)
+    return nullptr;
+
+  const auto nv = header->numberOfVertices;
+  const auto nt = header->numberOfTriangles;
+  auto triangles = (const TriangleMesh::Triangle*)
+    ((const char*)file.data() + header->triangleOffset);
+
+  for (int i = 0; i < nt; ++i)
+    for (auto v : triangles[i].v)
+      if (v < 0 || v >= nv)
+      {
+        fprintf(stderr, "%s: triangle %d is out of range\n", filename, i);
+        return nullptr;
+      }
+
+  TriangleMesh::Data data;
+
+  data.numberOfVertices = nv;
+  data.numberOfTriangles = nt;
+  data.vertices = internal::copyArray<vec3f>(file, header->vertexOffset, nv);
+  data.vertexNormals = internal::copyArray<vec3f>(file,
+    header->normalOffset,
+    nv);
+  data.uv = internal::copyArray<vec2f>(file, header->uvOffset, nv);
+  data.triangles = internal::copyArray<TriangleMesh::Triangle>(file,
+    header->triangleOffset,
+    nt);
+
+  auto mesh = new TriangleMesh{std::move(data)};
+
+  if (header->normalOffset == 0)
+    mesh->computeNormals();
+  return mesh;
+}
+
+bool
+MeshReader::readBinaryHeader(const char* filename, BinaryMeshHeader& header)
+{
+  MappedFile file{filename};
+
+  if (auto h = internal::binaryMeshHeader(file))
+  {
+    header = *h;
+    return true;
+  }
+  return false;
+}
+
+TriangleMesh*
+MeshReader::read(const char* filename)
+{
+  namespace fs = std::filesystem;
+
+  fs::path path{filename};
+
+  if (path.extension() == ".mesh")
+    return readBinary(filename);
+
+  auto binary = path;
+  std::error_code e1;
+  std::error_code e2;
+
+  binary.replace_extension(".mesh");
+
+  auto binaryTime = fs::last_write_time(binary, e1);
+  auto time = fs::last_write_time(path, e2);
+
+  // A stale or invalid binary file is ignored
+  if (!e1 && !e2 && binaryTime >= time)
+    if (auto mesh = readBinary(binary.string().c_str()))
+      return mesh;
+  return readOBJ(filename);
+}
+
 } // end namespace cg
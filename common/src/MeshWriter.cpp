@@ -0,0 +1,134 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: MeshWriter.cpp
+// ========
+// Source file for mesh writer.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#include "utils/MeshWriter.h"
+#include <cstdio>
+#include <cstring>
+
+namespace cg
+{ // begin namespace cg
+
+namespace internal
+{ // begin namespace internal
+
+inline uint64_t
+alignOffset(uint64_t offset)
+{
+  constexpr auto a = binaryMeshAlignment;
+  return (offset + a - 1) / a * a;
+}
+
+class BinaryMeshFile
+{
+public:
+  BinaryMeshFile(FILE* file):
+    _file{file}
+  {
+    // do nothing
+  }
+
+  // Writes the array at the next aligned offset, if any
+  uint64_t write(const void* data, size_t size)
+  {
+    if (data == nullptr)
+      return 0;
+
+    auto offset = alignOffset(_offset);
+    static const char zeros[binaryMeshAlignment]{};
+
+    _ok = _ok &&
+      fwrite(zeros, 1, size_t(offset - _offset), _file) == offset - _offset &&
+      fwrite(data, 1, size, _file) == size;
+    _offset = offset + size;
+    return offset;
+  }
+
+  bool ok() const
+  {
+    return _ok;
+  }
+
+private:
+  FILE* _file;
+  uint64_t _offset{sizeof(BinaryMeshHeader)};
+  bool _ok{true};
+
+}; // BinaryMeshFile
+
+} // end namespace internal
+
+
+//////////////////////////////////////////////////////////
+//
+// MeshWriter implementation
+// ==========
+bool
+MeshWriter::writeBinary(const char* filename, const TriangleMesh& mesh)
+{
+  auto file = std::fopen(filename, "wb");
+
+  if (file == nullptr)
+    return false;
+
+  const auto& data = mesh.data();
+  const auto nv = size_t(data.numberOfVertices);
+  const auto nt = size_t(data.numberOfTriangles);
+  auto bounds = mesh.bounds();
+  BinaryMeshHeader header{};
+
+  memcpy(header.magic, binaryMeshMagic, sizeof binaryMeshMagic);
+  header.version = binaryMeshVersion;
+  header.numberOfVertices = data.numberOfVertices;
+  header.numberOfTriangles = data.numberOfTriangles;
+  header.boundsMin = bounds.min();
+  header.boundsMax = bounds.max();
+
+  // The header is written last, when the offsets are known
+  internal::BinaryMeshFile out{file};
+  auto ok = fseek(file, sizeof header, SEEK_SET) == 0;
+
+  header.vertexOffset = out.write(data.vertices, nv * sizeof(vec3f));
+  header.normalOffset = out.write(data.vertexNormals, nv * sizeof(vec3f));
+  header.uvOffset = out.write(data.uv, nv * sizeof(vec2f));
+  header.triangleOffset = out.write(data.triangles,
+    nt * sizeof(TriangleMesh::Triangle));
+  ok = ok && out.ok() &&
+    fseek(file, 0, SEEK_SET) == 0 &&
+    fwrite(&header, sizeof header, 1, file) == 1;
+  ok = fclose(file) == 0 && ok;
+  // Never leave a truncated mesh behind
+  if (!ok)
+    remove(filename);
+  return ok;
+}
+
+} // end namespace cg
@@ -0,0 +1,235 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: Profiler.cpp
+// ========
+// Source file for scoped-zone profiler.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#include "core/Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace cg
+{ // begin namespace cg
+
+namespace internal
+{ // begin namespace internal
+
+using Clock = std::chrono::steady_clock;
+
+static const auto profilerStart = Clock::now();
+
+// Ring buffer of the events of a thread, allocated on its first event.
+// Only the owner thread writes the events; readers copy the last ones
+// and then drop those that may have been overwritten meanwhile
+struct ThreadBuffer
+{
+  uint32_t id;
+  std::string name;
+  std::unique_ptr<Profiler::Event[]> events;
+  std::atomic<uint64_t> count{0};
+
+  ThreadBuffer(uint32_t id):
+    id{id}
+  {
+    // do nothing
+  }
+
+}; // ThreadBuffer
+
+struct Registry
+{
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  std::atomic<int64_t> clearTime{-1};
+
+}; // Registry
+
+static Registry&
+registry()
+{
+  static Registry r;
+  return r;
+}
+
+// Buffers outlive their threads, so that traces include the events of
+// threads that have finished
+static ThreadBuffer&
+threadBuffer()
+{
+  static thread_local std::shared_ptr<ThreadBuffer> buffer;
+
+  if (buffer == nullptr)
+  {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock{r.mutex};
+
+    buffer = std::make_shared<ThreadBuffer>(uint32_t(r.buffers.size() + 1));
+    buffer->name = "Thread " + std::to_string(buffer->id);
+    r.buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+static void
+writeString(FILE* file, const char* s)
+{
+  fputc('"', file);
+  for (; *s; ++s)
+    if (*s == '"' || *s == '\\')
+      fprintf(file, "\\%c", *s);
+    else if ((unsigned char)*s >= ' ')
+      fputc(*s, file);
+  fputc('"', file);
+}
+
+} // end namespace internal
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Profiler implementation
+// ========
+std::atomic<bool> Profiler::_enabled;
+
+int64_t
+Profiler::now()
+{
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(internal::Clock::now() -
+    internal::profilerStart).count();
+}
+
+void
+Profiler::setThreadName(const char* name)
+{
+  auto& buffer = internal::threadBuffer();
+  std::lock_guard<std::mutex> lock{internal::registry().mutex};
+
+  buffer.name = name;
+}
+
+void
+Profiler::record(const char* name, int64_t begin, int64_t end, int depth)
+{
+  auto& buffer = internal::threadBuffer();
+  auto count = buffer.count.load(std::memory_order_relaxed);
+
+  if (count == 0)
+    buffer.events.reset(new Event[bufferSize]);
+  buffer.events[count % bufferSize] = {name, begin, end, depth};
+  buffer.count.store(count + 1, std::memory_order_release);
+}
+
+std::vector<Profiler::ThreadEvents>
+Profiler::events(int64_t since)
+{
+  auto& r = internal::registry();
+  std::vector<ThreadEvents> result;
+  std::lock_guard<std::mutex> lock{r.mutex};
+
+  since = std::max(since, r.clearTime.load() + 1);
+  for (const auto& buffer : r.buffers)
+  {
+    auto end = buffer->count.load(std::memory_order_acquire);
+    auto first = end > bufferSize ? end - bufferSize : 0;
+    ThreadEvents t{buffer->id, buffer->name, {}};
+
+    // Events are in order of their end, so scan back to since
+    for (auto i = end; i > first; --i)
+    {
+      const auto& e = buffer->events[(i - 1) % bufferSize];
+
+      if (e.end < since)
+        break;
+      t.events.push_back(e);
+    }
+
+    // Drop the events the owner thread may have overwritten meanwhile
+    auto last = buffer->count.load(std::memory_order_acquire);
+    auto oldest = last > bufferSize ? last - bufferSize : 0;
+
+    if (oldest > first)
+    {
+      auto kept = end > oldest ? end - oldest : 0;
+
+      if (t.events.size() > kept)
+        t.events.resize(size_t(kept));
+    }
+    std::reverse(t.events.begin(), t.events.end());
+    result.push_back(std::move(t));
+  }
+  return result;
+}
+
+void
+Profiler::clear()
+{
+  internal::registry().clearTime = now();
+}
+
+bool
+Profiler::writeTrace(const char* filename)
+{
+  auto file = std::fopen(filename, "w");
+
+  if (file == nullptr)
+    return false;
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  auto separator = "\n";
+
+  for (const auto& t : events())
+  {
+    fprintf(file,
+      "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+      "\"args\":{\"name\":",
+      separator,
+      t.id);
+    internal::writeString(file, t.name.c_str());
+    fprintf(file, "}}");
+    separator = ",\n";
+    for (const auto& e : t.events)
+    {
+      fprintf(file, ",\n{\"name\":");
+      internal::writeString(file, e.name);
+      fprintf(file,
+        ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+        t.id,
+        e.begin * 1e-3,
+        (e.end - e.begin) * 1e-3);
+    }
+  }
+  fprintf(file, "\n]}\n");
+  return fclose(file) == 0;
+}
+
+} // end namespace cg
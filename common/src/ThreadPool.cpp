@@ -0,0 +1,171 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: ThreadPool.cpp
+// ========
+// Source file for thread pool.
+//
+// Author: Paulo Pagliosa
+// Last revision: 17/10/2026
+
+#include "core/ThreadPool.h"
+#include "core/Profiler.h"
+#include <algorithm>
+#include <atomic>
+
+namespace cg
+{ // begin namespace cg
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// ThreadPool implementation
+// ==========
+ThreadPool::ThreadPool(int n)
+{
+  if (n <= 0)
+    n = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+  _workers.reserve(n);
+  for (int i = 0; i < n; ++i)
+    _workers.emplace_back([this, i]()
+    {
+      Profiler::setThreadName(("Worker " + std::to_string(i + 1)).c_str());
+      run();
+    });
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _stop = true;
+  }
+  _condition.notify_all();
+  for (auto& worker : _workers)
+    worker.join();
+}
+
+void
+ThreadPool::enqueue(Task&& task)
+{
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _tasks.push_back(std::move(task));
+  }
+  _condition.notify_one();
+}
+
+void
+ThreadPool::run()
+{
+  for (;;)
+  {
+    Task task;
+
+    {
+      std::unique_lock<std::mutex> lock{_mutex};
+
+      _condition.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+      if (_tasks.empty())
+        return;
+      task = std::move(_tasks.front());
+      _tasks.pop_front();
+    }
+    task();
+  }
+}
+
+namespace internal
+{ // begin namespace internal
+
+struct ParallelFor
+{
+  ThreadPool::IndexFunction f;
+  int count;
+  std::atomic<int> next{0};
+  std::atomic<int> done{0};
+  std::mutex mutex;
+  std::condition_variable finished;
+
+  ParallelFor(const ThreadPool::IndexFunction& f, int count):
+    f{f},
+    count{count}
+  {
+    // do nothing
+  }
+
+  void run(int slot)
+  {
+    for (int i; (i = next++) < count;)
+    {
+      f(i, slot);
+      if (++done == count)
+      {
+        std::lock_guard<std::mutex> lock{mutex};
+        finished.notify_all();
+      }
+    }
+  }
+
+}; // ParallelFor
+
+} // end namespace internal
+
+void
+ThreadPool::parallelFor(int count, const IndexFunction& f, int threads)
+{
+  if (count <= 0)
+    return;
+
+  auto n = std::min(concurrency(threads), count);
+
+  if (n == 1)
+  {
+    for (int i = 0; i < count; ++i)
+      f(i, 0);
+    return;
+  }
+
+  // The loop state is shared with the helper tasks, which can start
+  // after this function has returned and then just find no indices left
+  auto loop = std::make_shared<internal::ParallelFor>(f, count);
+
+  for (int slot = 1; slot < n; ++slot)
+    enqueue([loop, slot]() { loop->run(slot); });
+  loop->run(0);
+
+  std::unique_lock<std::mutex> lock{loop->mutex};
+
+  loop->finished.wait(lock, [&loop]() { return loop->done == loop->count; });
+}
+
+ThreadPool&
+ThreadPool::global()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+} // end namespace cg
@@ -31,6 +31,8 @@
 // Last revision: 02/06/2019
 
 #include "geometry/MeshSweeper.h"
+#include "core/Profiler.h"
+#include <cstring>
 #include <memory>
 
 namespace cg
@@ -71,6 +73,8 @@ TriangleMesh::bounds() const
 void
 TriangleMesh::computeNormals()
 {
+  PROFILE_ZONE("TriangleMesh::computeNormals");
+
   auto nv = _data.numberOfVertices;
 
   if (_data.vertexNormals == nullptr)
@@ -101,6 +105,7 @@ TriangleMesh::TRS(const mat4f& trs)
 
   for (int i = 0; i < nv; ++i)
     _data.vertices[i] = trs.transform3x4(_data.vertices[i]);
+  ++_version;
   if (_data.vertexNormals == nullptr)
     return;
 
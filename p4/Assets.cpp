@@ -31,7 +31,13 @@
 // Last revision: 01/10/2019
 
 #include "Assets.h"
+#include "Scenes.h"
+#include "core/Profiler.h"
+#include "core/ThreadPool.h"
+#include "geometry/MeshSweeper.h"
 #include "graphics/Application.h"
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 
 namespace cg
@@ -39,12 +45,20 @@ namespace cg
 
 namespace fs = std::filesystem;
 
+inline std::string
+meshFilePath(const std::string& name)
+{
+  return Application::assetFilePath(("meshes/" + name).c_str());
+}
+
 
 /////////////////////////////////////////////////////////////////////
 //
 // Assets implementation
 // ======
 MeshMap Assets::_meshes;
+std::map<std::string, Assets::PendingMesh> Assets::_pendingMeshes;
+std::set<std::string> Assets::_failedMeshes;
 
 void
 Assets::initialize()
@@ -56,8 +70,18 @@ Assets::initialize()
     auto p = fs::directory_iterator(meshPath);
 
     for (auto e = fs::directory_iterator(); p != e; ++p)
-      if (fs::is_regular_file(p->status()))
-        _meshes[p->path().filename().string()] = nullptr;
+    {
+      if (!fs::is_regular_file(p->status()))
+        continue;
+
+      auto path = p->path();
+
+      // The binary version of an OBJ file is loaded in its place
+      if (path.extension() == ".mesh" &&
+        fs::exists(fs::path{path}.replace_extension(".obj")))
+        continue;
+      _meshes[path.filename().string()] = nullptr;
+    }
   }
 }
 
@@ -69,14 +93,118 @@ Assets::loadMesh(MeshMapIterator mit)
 
   TriangleMesh* m{mit->second};
 
-  if (m == nullptr)
+  if (m == nullptr && !hasFailed(mit))
   {
-    auto filename = "meshes/" + mit->first;
+    PROFILE_ZONE("Assets::loadMesh");
 
-    m = Application::loadMesh(filename.c_str());
+    auto pit = _pendingMeshes.find(mit->first);
+
+    // A mesh being loaded in background is waited for, not read again
+    if (pit != _pendingMeshes.end())
+      m = pit->second.future.get().mesh;
+    else
+      m = Application::loadMesh(("meshes/" + mit->first).c_str());
+    if (m == nullptr)
+      _failedMeshes.insert(mit->first);
     _meshes[mit->first] = m;
   }
   return m;
 }
 
+MeshFuture
+Assets::loadMeshAsync(MeshMapIterator mit, MeshCallback done)
+{
+  if (mit == _meshes.end())
+    return {};
+  if (mit->second != nullptr || hasFailed(mit))
+  {
+    std::promise<AsyncMesh> loaded;
+
+    // The BVH of a mesh already loaded is kept by its users
+    loaded.set_value({mit->second, nullptr});
+    if (done)
+      done(mit->second, nullptr);
+    return loaded.get_future().share();
+  }
+
+  auto& pending = _pendingMeshes[mit->first];
+
+  if (done)
+    pending.callbacks.push_back(std::move(done));
+  if (!pending.future.valid())
+  {
+    auto filename = meshFilePath(mit->first);
+    auto cacheDir = Application::assetFilePath("meshes/cache/");
+
+    pending.future = ThreadPool::global().submit([filename, cacheDir]()
+      {
+        PROFILE_ZONE("Assets::loadMeshAsync");
+
+        AsyncMesh loaded{MeshReader::read(filename.c_str()), nullptr};
+
+        if (loaded.mesh != nullptr)
+          loaded.bvh = cachedBVH(*loaded.mesh, cacheDir);
+        return loaded;
+      }).share();
+  }
+  return pending.future;
+}
+
+TriangleMesh*
+Assets::makePlaceholder(MeshMapIterator mit)
+{
+  fs::path path{meshFilePath(mit->first)};
+  BinaryMeshHeader header;
+
+  if (path.extension() != ".mesh")
+    path.replace_extension(".mesh");
+
+  // The bounds are unknown if the mesh has no binary file yet
+  auto hasHeader = MeshReader::readBinaryHeader(path.string().c_str(), header);
+  const Bounds3f bounds = hasHeader ?
+    Bounds3f{header.boundsMin, header.boundsMax} :
+    Bounds3f{vec3f{-1, -1, -1}, vec3f{1, 1, 1}};
+
+  // The box of MeshSweeper is [-1,1]^3
+  auto size = bounds.size() * 0.5f;
+  auto box = MeshSweeper::makeBox();
+
+  for (int i = 0; i < 3; ++i)
+    size[i] = std::max(size[i], 1e-3f * bounds.maxSize());
+  box->TRS(mat4f::TRS(bounds.center(), quatf::identity(), size));
+  return box;
+}
+
+void
+Assets::update()
+{
+  for (auto pit = _pendingMeshes.begin(); pit != _pendingMeshes.end();)
+  {
+    auto& pending = pit->second;
+
+    if (pending.future.wait_for(std::chrono::seconds{0}) !=
+      std::future_status::ready)
+    {
+      ++pit;
+      continue;
+    }
+
+    const auto& loaded = pending.future.get();
+    MeshRef mesh{loaded.mesh};
+    Reference<BVH> bvh{loaded.bvh};
+
+    // A mesh that could not be loaded is marked as failed, so that it
+    // is not read again, and its callbacks are called with nulls
+    if (mesh == nullptr)
+    {
+      fprintf(stderr, "Unable to load mesh %s\n", pit->first.c_str());
+      _failedMeshes.insert(pit->first);
+    }
+    _meshes[pit->first] = mesh;
+    for (auto& done : pending.callbacks)
+      done(mesh, bvh);
+    pit = _pendingMeshes.erase(pit);
+  }
+}
+
 } // end namespace cg
@@ -33,9 +33,14 @@
 #ifndef __Assets_h
 #define __Assets_h
 
+#include "BVH.h"
 #include "utils/MeshReader.h"
+#include <functional>
+#include <future>
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 namespace cg
 { // begin namespace cg
@@ -44,6 +49,19 @@ using MeshRef = Reference<TriangleMesh>;
 using MeshMap = std::map<std::string, MeshRef>;
 using MeshMapIterator = typename MeshMap::const_iterator;
 
+// Mesh loaded in background and its BVH (both null if the mesh
+// could not be loaded). Reference counts are not atomic, so the
+// loader hands over raw pointers that are referenced by update()
+struct AsyncMesh
+{
+  TriangleMesh* mesh;
+  BVH* bvh;
+
+}; // AsyncMesh
+
+using MeshFuture = std::shared_future<AsyncMesh>;
+using MeshCallback = std::function<void(TriangleMesh*, BVH*)>;
+
 
 /////////////////////////////////////////////////////////////////////
 //
@@ -61,8 +79,44 @@ public:
 
   static TriangleMesh* loadMesh(MeshMapIterator mit);
 
+  // Loads the mesh of mit and builds its BVH on the global thread
+  // pool. When the mesh is ready, update() stores it in the mesh map
+  // and calls done (on the thread calling update()). If the mesh could
+  // not be loaded, done is called with null pointers
+  static MeshFuture loadMeshAsync(MeshMapIterator mit,
+    MeshCallback done = {});
+
+  static bool isLoading(MeshMapIterator mit)
+  {
+    return _pendingMeshes.count(mit->first) != 0;
+  }
+
+  // Returns true if the mesh of mit could not be loaded. Such a mesh
+  // is not read again
+  static bool hasFailed(MeshMapIterator mit)
+  {
+    return _failedMeshes.count(mit->first) != 0;
+  }
+
+  // Returns a box with the bounds of the mesh of mit, which are read
+  // from its binary file, if any, to stand for it while it is loaded
+  static TriangleMesh* makePlaceholder(MeshMapIterator mit);
+
+  // Collects the meshes loaded in background. Must be called by the
+  // thread owning the scene (e.g., once per frame)
+  static void update();
+
 private:
+  struct PendingMesh
+  {
+    MeshFuture future;
+    std::vector<MeshCallback> callbacks;
+
+  }; // PendingMesh
+
   static MeshMap _meshes;
+  static std::map<std::string, PendingMesh> _pendingMeshes;
+  static std::set<std::string> _failedMeshes;
 
 }; // Assets
 
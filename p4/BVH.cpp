@@ -31,8 +31,21 @@
 // Last revision: 18/11/2019
 
 #include "BVH.h"
-#include <stack>
+#ifdef BVH_SIMD
+#include <emmintrin.h>
+#endif // BVH_SIMD
 #include "Primitive.h"
+#include "RayPacket.h"
+#include "RayStats.h"
+#include "core/Profiler.h"
+#include "core/ThreadPool.h"
+#include "utils/MappedFile.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
 #include "Transform.h"
 #include "SceneObject.h"
 
@@ -57,23 +70,28 @@ namespace cg
 
   }; // BVH::TriangleInfo
 
+  // Build node. The tree is flattened into a LinearNode array after
+  // it has been built
   struct BVH::Node
   {
     Bounds3f bounds;
     Node* children[2];
     int first;
     int count;
+    int axis;
 
     Node(const Bounds3f& b, int first, int count) :
       bounds{ b },
       first{ first },
-      count{ count }
+      count{ count },
+      axis{ 0 }
     {
       children[0] = children[1] = nullptr;
     }
 
-    Node(Node* c0, Node* c1) :
-      count{ 0 }
+    Node(Node* c0, Node* c1, int axis) :
+      count{ 0 },
+      axis{ axis }
     {
       bounds.inflate(c0->bounds);
       bounds.inflate(c1->bounds);
@@ -92,23 +110,175 @@ namespace cg
       return children[0] == nullptr;
     }
 
-    static void iterate(const Node* node, BVHNodeFunction f);
-
   }; // BVH::Node
 
+  // Size of the traversal stacks. A traversal pushes at most one
+  // entry per level, so builds keep leaves at most maxDepth deep
+  constexpr auto maxStackSize = 64;
+  constexpr auto maxDepth = maxStackSize - 1;
+
+  // Depth of a subtree of n triangles built by median splits
+  inline int
+    medianDepth(int n)
+  {
+    int depth = 0;
+
+    while ((int64_t(1) << depth) < n)
+      ++depth;
+    return depth;
+  }
+
+  int
+    BVH::flatten(const Node* node)
+  {
+    auto index = int(_nodes.size());
+
+    _nodes.push_back({ node->bounds,
+      node->first,
+      uint16_t(node->count),
+      uint8_t(node->axis) });
+    if (!node->isLeaf())
+    {
+      flatten(node->children[0]);
+      _nodes[index].offset = flatten(node->children[1]);
+    }
+    return index;
+  }
+
+  int
+    BVH::collapse(int index)
+  {
+    // Gather up to four descendants of the binary node, opening the
+    // interior descendant with the largest area first
+    int children[4];
+    int n = 0;
+
+    if (_nodes[index].isLeaf())
+      children[n++] = index;
+    else
+    {
+      children[n++] = index + 1;
+      children[n++] = _nodes[index].offset;
+      while (n < 4)
+      {
+        auto best = -1;
+        auto bestArea = -1.0f;
+
+        for (int i = 0; i < n; ++i)
+        {
+          const auto& c = _nodes[children[i]];
+
+          if (!c.isLeaf() && c.bounds.area() > bestArea)
+          {
+            best = i;
+            bestArea = c.bounds.area();
+          }
+        }
+        if (best < 0)
+          break;
+
+        auto c = children[best];
+
+        children[best] = c + 1;
+        children[n++] = _nodes[c].offset;
+      }
+    }
+
+    const auto inf = math::Limits<float>::inf();
+    auto w = int(_wideNodes.size());
+
+    _wideNodes.emplace_back();
+    _wideSources.resize(4 * (w + 1), -1);
+    for (int i = 0; i < 4; ++i)
+    {
+      auto& node = _wideNodes[w];
+
+      if (i >= n)
+      {
+        node.minX[i] = node.minY[i] = node.minZ[i] = +inf;
+        node.maxX[i] = node.maxY[i] = node.maxZ[i] = -inf;
+        node.child[i] = -1;
+        node.count[i] = 0;
+        continue;
+      }
+
+      const auto& c = _nodes[children[i]];
+      const auto& p1 = c.bounds.min();
+      const auto& p2 = c.bounds.max();
+
+      node.minX[i] = p1.x;
+      node.minY[i] = p1.y;
+      node.minZ[i] = p1.z;
+      node.maxX[i] = p2.x;
+      node.maxY[i] = p2.y;
+      node.maxZ[i] = p2.z;
+      node.count[i] = c.count;
+      node.child[i] = 0;
+      _wideSources[4 * w + i] = children[i];
+      if (c.isLeaf())
+        node.child[i] = _leafBlocks[children[i]] =
+          makeBlocks(c.offset, c.count);
+    }
+    // collapse() appends to _wideNodes, so do not keep references
+    for (int i = 0; i < n; ++i)
+      if (!_nodes[children[i]].isLeaf())
+      {
+        auto c = collapse(children[i]);
+        _wideNodes[w].child[i] = c;
+      }
+    return w;
+  }
+
+  int
+    BVH::makeBlocks(int first, int count)
+  {
+    auto index = int(_blocks.size());
+
+    _blocks.resize(index + (count + 3) / 4);
+    memset(_blocks.data() + index,
+      0,
+      (_blocks.size() - index) * sizeof(TriangleBlock));
+    fillBlocks(index, first, count);
+    return index;
+  }
+
   void
-    BVH::Node::iterate(const Node* node, BVHNodeFunction f)
+    BVH::fillBlocks(int index, int first, int count)
   {
-    if (node == nullptr)
-      return;
+    const auto& data = _mesh->data();
+
+    for (int i = 0; i < count; ++i)
+    {
+      auto& block = _blocks[index + i / 4];
+      auto k = i % 4;
+      auto t = _triangles[first + i];
+      auto p0 = data.vertices[data.triangles[t].v[0]];
+      auto p1 = data.vertices[data.triangles[t].v[1]];
+      auto p2 = data.vertices[data.triangles[t].v[2]];
+      vec3f e1 = p1 - p0;
+      vec3f e2 = p2 - p0;
+
+      for (int j = 0; j < 3; ++j)
+      {
+        block.v0[j][k] = p0[j];
+        block.e1[j][k] = e1[j];
+        block.e2[j][k] = e2[j];
+      }
+      block.index[k] = t;
+    }
+  }
 
-    auto isLeaf = node->isLeaf();
+  void
+    BVH::iterate(int index, BVHNodeFunction& f) const
+  {
+    const auto& node = _nodes[index];
+    auto isLeaf = node.isLeaf();
 
-    f({ node->bounds, isLeaf, node->first, node->count });
+    f({ node.bounds, isLeaf, isLeaf ? node.offset : 0, node.count });
     if (!isLeaf)
     {
-      iterate(node->children[0], f);
-      iterate(node->children[1], f);
+      iterate(index + 1, f);
+      iterate(node.offset, f);
     }
   }
 
@@ -119,44 +289,152 @@ namespace cg
       TriangleIndexArray& orderedTris)
   {
     Bounds3f bounds;
-    auto first = int(orderedTris.size());
 
+    // Each leaf owns the range [start, end) of the ordered triangles,
+    // so subtrees built in parallel never write to the same place
     for (int i = start; i < end; ++i)
     {
       bounds.inflate(triangleInfo[i].bounds);
-      orderedTris.push_back(_triangles[triangleInfo[i].index]);
+      orderedTris[i] = _triangles[triangleInfo[i].index];
     }
-    return new Node{ bounds, first, end - start };
+    return new Node{ bounds, start, end - start };
   }
 
+  // Nodes with fewer triangles are built by a single thread
+  constexpr auto parallelBuildSize = 4096;
+  // Number of triangles of each task of the parallel loops
+  constexpr auto buildChunkSize = 2048;
+
   inline auto
-    maxDim(const Bounds3f& b)
+    numberOfChunks(int n)
   {
-    auto s = b.size();
-    return s.x > s.y&& s.x > s.z ? 0 : (s.y > s.z ? 1 : 2);
+    return (n + buildChunkSize - 1) / buildChunkSize;
   }
 
-  BVH::Node*
-    BVH::makeNode(TriangleInfoArray& triangleInfo,
+  // Invokes f(chunk, s, e) for the chunks [s, e) of [start, end) in
+  // parallel. Results merged in chunk order do not depend on threads
+  template <typename F>
+  inline void
+    forEachChunk(int start, int end, const F& f)
+  {
+    ThreadPool::global().parallelFor(numberOfChunks(end - start),
+      [&](int chunk, int)
+      {
+        auto s = start + chunk * buildChunkSize;
+        f(chunk, s, std::min(s + buildChunkSize, end));
+      });
+  }
+
+  // Stable parallel partition of [start, end). Returns the index of
+  // the first element for which pred is false
+  template <typename T, typename P>
+  int
+    parallelPartition(std::vector<T>& a, int start, int end, const P& pred)
+  {
+    auto n = numberOfChunks(end - start);
+    std::vector<int> count(n);
+
+    forEachChunk(start, end, [&](int chunk, int s, int e)
+      {
+        int c = 0;
+
+        for (int i = s; i < e; ++i)
+          c += pred(a[i]) ? 1 : 0;
+        count[chunk] = c;
+      });
+
+    std::vector<int> left(n);
+    std::vector<int> right(n);
+    int total = 0;
+
+    for (int i = 0; i < n; ++i)
+    {
+      left[i] = total;
+      total += count[i];
+    }
+    for (int i = 0, r = total; i < n; ++i)
+    {
+      right[i] = r;
+      r += std::min(buildChunkSize, end - start - i * buildChunkSize) -
+        count[i];
+    }
+
+    std::vector<T> temp(end - start);
+
+    forEachChunk(start, end, [&](int chunk, int s, int e)
+      {
+        auto l = left[chunk];
+        auto r = right[chunk];
+
+        for (int i = s; i < e; ++i)
+          temp[pred(a[i]) ? l++ : r++] = a[i];
+      });
+    forEachChunk(start, end, [&](int, int s, int e)
+      {
+        std::copy(&temp[s - start], &temp[e - start - 1] + 1, &a[s]);
+      });
+    return start + total;
+  }
+
+  void
+    BVH::computeBounds(const TriangleInfoArray& triangleInfo,
       int start,
       int end,
-      TriangleIndexArray& orderedTris)
+      Bounds3f& bounds,
+      Bounds3f& centroidBounds) const
   {
-    ++_nodeCount;
-    if (end - start <= _maxTrisPerNode)
-      return makeLeaf(triangleInfo, start, end, orderedTris);
+    if (end - start < parallelBuildSize)
+    {
+      for (int i = start; i < end; ++i)
+      {
+        bounds.inflate(triangleInfo[i].bounds);
+        centroidBounds.inflate(triangleInfo[i].centroid);
+      }
+      return;
+    }
 
-    Bounds3f centroidBounds;
+    // Parallel reduction
+    std::vector<Bounds3f> partial(2 * numberOfChunks(end - start));
 
-    for (int i = start; i < end; ++i)
-      centroidBounds.inflate(triangleInfo[i].centroid);
+    forEachChunk(start, end, [&](int chunk, int s, int e)
+      {
+        computeBounds(triangleInfo,
+          s,
+          e,
+          partial[2 * chunk],
+          partial[2 * chunk + 1]);
+      });
+    for (size_t i = 0; i < partial.size(); i += 2)
+    {
+      bounds.inflate(partial[i]);
+      centroidBounds.inflate(partial[i + 1]);
+    }
+  }
 
-    auto dim = maxDim(centroidBounds);
+  inline auto
+    maxDim(const Bounds3f& b)
+  {
+    auto s = b.size();
+    return s.x > s.y&& s.x > s.z ? 0 : (s.y > s.z ? 1 : 2);
+  }
 
-    if (centroidBounds.max()[dim] == centroidBounds.min()[dim])
-      return makeLeaf(triangleInfo, start, end, orderedTris);
+  // SAH costs are relative to the cost of one ray/triangle test
+  constexpr auto sahTraversalCost = 0.125f;
+  constexpr auto sahBins = 16;
+
+  inline auto
+    sahBin(const vec3f& centroid, int dim, float min, float scale)
+  {
+    auto b = int((centroid[dim] - min) * scale);
+    return b < sahBins ? b : sahBins - 1;
+  }
 
-    // Partition tris into two sets and build children
+  int
+    BVH::splitMedian(TriangleInfoArray& triangleInfo,
+      int start,
+      int end,
+      int dim)
+  {
     auto mid = (start + end) / 2;
 
     std::nth_element(&triangleInfo[start],
@@ -166,155 +444,1399 @@ namespace cg
       {
         return a.centroid[dim] < b.centroid[dim];
       });
-    return new Node{ makeNode(triangleInfo, start, mid, orderedTris),
-      makeNode(triangleInfo, mid, end, orderedTris) };
+    return mid;
   }
 
-  BVH::BVH(TriangleMesh& mesh, int maxTrisPerNode) :
-    _mesh{ &mesh },
-    _maxTrisPerNode{ maxTrisPerNode }
+  int
+    BVH::splitSAH(TriangleInfoArray& triangleInfo,
+      int start,
+      int end,
+      const Bounds3f& bounds,
+      const Bounds3f& centroidBounds,
+      int& dim)
   {
-    const auto& data = mesh.data();
-    int nt{ data.numberOfTriangles };
-
-    if (nt == 0)
-      return;
-    _triangles.resize(nt);
+    struct Bin
+    {
+      Bounds3f bounds;
+      int count{};
 
-    TriangleInfoArray triangleInfo(nt);
+    };
 
-    for (int i = 0; i < nt; ++i)
+    struct Bins
     {
-      _triangles[i] = i;
+      Bin bins[3][sahBins];
 
-      auto t = data.triangles + i;
-      Bounds3f b;
+      void merge(const Bins& other)
+      {
+        for (int dim = 0; dim < 3; ++dim)
+          for (int i = 0; i < sahBins; ++i)
+            if (other.bins[dim][i].count > 0)
+            {
+              // Inflating by empty bounds would make them infinite
+              bins[dim][i].bounds.inflate(other.bins[dim][i].bounds);
+              bins[dim][i].count += other.bins[dim][i].count;
+            }
+      }
+
+    } all;
+    float min[3];
+    float scale[3];
 
-      b.inflate(data.vertices[t->v[0]]);
-      b.inflate(data.vertices[t->v[1]]);
-      b.inflate(data.vertices[t->v[2]]);
-      triangleInfo[i] = { i, b };
+    for (int dim = 0; dim < 3; ++dim)
+    {
+      auto extent = centroidBounds.max()[dim] - centroidBounds.min()[dim];
+
+      min[dim] = centroidBounds.min()[dim];
+      scale[dim] = extent > 0 ? sahBins / extent : 0;
     }
 
-    TriangleIndexArray orderedTris;
+    // Bin the triangles along the three axes, in parallel for large
+    // nodes; counts and bounds merge exactly, in any order
+    auto binTriangles = [&](Bins& bins, int s, int e)
+    {
+      for (int dim = 0; dim < 3; ++dim)
+      {
+        if (scale[dim] == 0)
+          continue;
+        for (int i = s; i < e; ++i)
+        {
+          const auto& t = triangleInfo[i];
+          auto& bin = bins.bins[dim][sahBin(t.centroid,
+            dim,
+            min[dim],
+            scale[dim])];
+
+          bin.bounds.inflate(t.bounds);
+          bin.count++;
+        }
+      }
+    };
 
-    orderedTris.reserve(nt);
-    _root = makeNode(triangleInfo, 0, nt, orderedTris);
-    _triangles.swap(orderedTris);
-#ifdef _DEBUG
-    if (true)
+    if (end - start < parallelBuildSize)
+      binTriangles(all, start, end);
+    else
     {
-      mesh.bounds().print("Mesh bounds:");
-      printf("Mesh triangles: %d\n", nt);
-      bounds().print("BVH bounds:");
-      printf("BVH nodes: %d\n", _nodeCount);
-      iterate([this](const BVHNodeInfo& node)
+      std::vector<Bins> partial(numberOfChunks(end - start));
+
+      forEachChunk(start, end, [&](int chunk, int s, int e)
         {
-          if (!node.isLeaf)
-            return;
-          node.bounds.print("Leaf bounds:");
-          printf("Leaf triangles: %d\n", node.numberOfTriangles);
-          //for (int i = 0; i < node.numberOfTriangles; ++i)
-            //printf("%d ", _triangles[node.firstTriangleIndex + i]);
-          //putchar('\n');
+          binTriangles(partial[chunk], s, e);
         });
-      putchar('\n');
+      for (const auto& bins : partial)
+        all.merge(bins);
     }
-#endif // _DEBUG
+
+    float rightArea[sahBins - 1];
+    int rightCount[sahBins - 1];
+    auto bestCost = math::Limits<float>::inf();
+    auto bestDim = -1;
+    auto bestSplit = -1;
+
+    // Sweep the bin boundaries of the three axes
+    for (int dim = 0; dim < 3; ++dim)
+    {
+      if (scale[dim] == 0)
+        continue;
+
+      const auto& bins = all.bins[dim];
+      Bounds3f b;
+      int count{};
+
+      for (int i = sahBins - 1; i > 0; --i)
+      {
+        if (bins[i].count > 0)
+          b.inflate(bins[i].bounds);
+        rightCount[i - 1] = count += bins[i].count;
+        rightArea[i - 1] = count > 0 ? b.area() : 0;
+      }
+      b.setEmpty();
+      count = 0;
+      for (int i = 0; i < sahBins - 1; ++i)
+      {
+        if (bins[i].count > 0)
+          b.inflate(bins[i].bounds);
+        count += bins[i].count;
+        if (count == 0 || rightCount[i] == 0)
+          continue;
+
+        auto cost = count * b.area() + rightCount[i] * rightArea[i];
+
+        if (cost < bestCost)
+        {
+          bestCost = cost;
+          bestDim = dim;
+          bestSplit = i;
+        }
+      }
+    }
+    if (bestDim < 0)
+      return -1;
+
+    // Make a leaf if it is cheaper than the best split and small enough
+    auto area = bounds.area();
+    auto splitCost = sahTraversalCost + (area > 0 ? bestCost / area : 0);
+
+    if (end - start <= _maxTrisPerNode && float(end - start) <= splitCost)
+      return -1;
+
+    auto m = min[bestDim];
+    auto s = scale[bestDim];
+    auto isLeft = [=](const TriangleInfo& t)
+    {
+      return sahBin(t.centroid, bestDim, m, s) <= bestSplit;
+    };
+
+    dim = bestDim;
+    if (end - start >= parallelBuildSize)
+      return parallelPartition(triangleInfo, start, end, isLeft);
+
+    auto mid = std::partition(&triangleInfo[start],
+      &triangleInfo[end - 1] + 1,
+      isLeft);
+
+    return int(mid - &triangleInfo[0]);
   }
 
-  BVH::~BVH()
+  BVH::Node*
+    BVH::makeNode(TriangleInfoArray& triangleInfo,
+      int start,
+      int end,
+      TriangleIndexArray& orderedTris,
+      int depth)
   {
-    delete _root;
+    auto n = end - start;
+    // Skewed SAH splits can nest deeper than the traversal stacks, so
+    // median splits, which halve n, take over near the depth limit
+    auto median = _splitMethod != SplitMethod::SAH ||
+      depth + medianDepth(n) >= maxDepth;
+
+    if (n == 1 || (n <= _maxTrisPerNode && median))
+      return makeLeaf(triangleInfo, start, end, orderedTris);
+    // Leaf sizes must fit in LinearNode::count
+    constexpr auto maxLeafSize = 0xffff;
+
+    Bounds3f bounds;
+    Bounds3f centroidBounds;
+
+    computeBounds(triangleInfo, start, end, bounds, centroidBounds);
+
+    auto dim = maxDim(centroidBounds);
+    int mid;
+
+    if (centroidBounds.max()[dim] == centroidBounds.min()[dim])
+    {
+      if (n <= maxLeafSize)
+        return makeLeaf(triangleInfo, start, end, orderedTris);
+      mid = (start + end) / 2;
+    }
+    else
+    {
+      // Partition tris into two sets and build children
+      mid = median ?
+        splitMedian(triangleInfo, start, end, dim) :
+        splitSAH(triangleInfo, start, end, bounds, centroidBounds, dim);
+      if (mid < 0)
+        return makeLeaf(triangleInfo, start, end, orderedTris);
+    }
+
+    Node* children[2];
+
+    // The children of large nodes are built as parallel tasks; their
+    // triangle ranges are disjoint, so they share no data
+    if (n >= parallelBuildSize)
+      ThreadPool::global().parallelFor(2, [&](int i, int)
+        {
+          children[i] = i == 0 ?
+            makeNode(triangleInfo, start, mid, orderedTris, depth + 1) :
+            makeNode(triangleInfo, mid, end, orderedTris, depth + 1);
+        });
+    else
+    {
+      children[0] = makeNode(triangleInfo, start, mid, orderedTris, depth + 1);
+      children[1] = makeNode(triangleInfo, mid, end, orderedTris, depth + 1);
+    }
+    return new Node{ children[0], children[1], dim };
   }
 
-  Bounds3f
-    BVH::bounds() const
+  // Spreads the 21 lowest bits of x to every third bit
+  inline uint64_t
+    expandBits(uint64_t x)
   {
-    return _root == nullptr ? Bounds3f{} : _root->bounds;
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x << 8) & 0x100f00f00f00f00full;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+    x = (x | x << 2) & 0x1249249249249249ull;
+    return x;
   }
 
-  void
-    BVH::iterate(BVHNodeFunction f) const
+  // Morton code with bits bits per axis of a point in [0,1]^3. Bit 3k+2
+  // holds bit k of x, bit 3k+1 of y, and bit 3k of z
+  inline uint64_t
+    mortonCode(const vec3f& p, int bits)
   {
-    Node::iterate(_root, f);
+    const auto scale = float(1 << bits);
+    const auto max = scale - 1;
+    auto x = uint64_t(std::min(std::max(p.x * scale, 0.0f), max));
+    auto y = uint64_t(std::min(std::max(p.y * scale, 0.0f), max));
+    auto z = uint64_t(std::min(std::max(p.z * scale, 0.0f), max));
+
+    return expandBits(x) << 2 | expandBits(y) << 1 | expandBits(z);
   }
 
-  bool
-    BVH::intersect(const Ray& ray, Intersection& hit, float d) const
+  inline int
+    countLeadingZeros(uint64_t x)
   {
-    std::stack<Node*> stck;
-
-    float tMin, tMax;
+#ifdef _MSC_VER
+    unsigned long i;
 
-    stck.push(_root);
+    _BitScanReverse64(&i, x);
+    return 63 - int(i);
+#else
+    return __builtin_clzll(x);
+#endif // _MSC_VER
+  }
 
-    bool intersect = false;
+  // Stable LSD radix sort of codes, and of index along, on their bits
+  // lowest bits. Chunk histograms are built and scattered in parallel
+  void
+    radixSort(std::vector<uint64_t>& codes, std::vector<int>& index, int bits)
+  {
+    constexpr auto digitBits = 8;
+    constexpr auto radix = 1 << digitBits;
+    const auto n = int(codes.size());
+    const auto chunks = numberOfChunks(n);
+    std::vector<uint64_t> sortedCodes(n);
+    std::vector<int> sortedIndex(n);
+    std::vector<int> offset(size_t(chunks) * radix);
 
-    while (!stck.empty())
+    for (int shift = 0; shift < bits; shift += digitBits)
     {
-      auto no = stck.top();
-      stck.pop();
+      std::fill(offset.begin(), offset.end(), 0);
+      forEachChunk(0, n, [&](int chunk, int s, int e)
+        {
+          auto h = &offset[size_t(chunk) * radix];
 
-      if (no->bounds.intersect(ray, tMin, tMax))
-      {
-        if (!no->isLeaf()) {
-          stck.push(no->children[0]);
-          stck.push(no->children[1]);
+          for (int i = s; i < e; ++i)
+            h[codes[i] >> shift & (radix - 1)]++;
+        });
+      // Digit-major, chunk-minor prefix sums keep the sort stable
+      for (int d = 0, sum = 0; d < radix; ++d)
+        for (int c = 0; c < chunks; ++c)
+        {
+          auto& h = offset[size_t(c) * radix + d];
+          auto count = h;
+
+          h = sum;
+          sum += count;
         }
-        else
+      forEachChunk(0, n, [&](int chunk, int s, int e)
         {
-          if (_mesh == nullptr)
-            return false;          
-          auto distance = math::Limits<float>::inf();
-          auto triangles = _mesh->data().triangles;
-          auto numTriangles = _mesh->data().numberOfTriangles;
-          auto vertexArray = _mesh->data().vertices;
-          for (int i = no->first; i < no->first + no->count; i++)
+          auto h = &offset[size_t(chunk) * radix];
+
+          for (int i = s; i < e; ++i)
           {
-            auto p0 = vertexArray[triangles[_triangles[i]].v[0]];
-            auto p1 = vertexArray[triangles[_triangles[i]].v[1]];
-            auto p2 = vertexArray[triangles[_triangles[i]].v[2]];
+            auto j = h[codes[i] >> shift & (radix - 1)]++;
 
-            vec3f e1 = p1 - p0;// #1
-            vec3f e2 = p2 - p0;// #2
-            vec3f s1 = ray.direction.cross(e2);// #3
+            sortedCodes[j] = codes[i];
+            sortedIndex[j] = index[i];
+          }
+        });
+      codes.swap(sortedCodes);
+      index.swap(sortedIndex);
+    }
+  }
 
-            auto s1_e1 = s1.dot(e1);
+  // Binary radix tree over sorted Morton codes (Karras, 2012). Internal
+  // node i has children left and right, which are leaves ~k if negative
+  struct BVH::LBVH
+  {
+    struct Node
+    {
+      int left;
+      int right;
+      int first;
+      int last;
 
-            if (math::isZero(abs(s1_e1))) continue; //#4
+    }; // Node
 
-            auto invD = math::inverse(s1_e1);
-            if (math::isZero(abs(invD))) continue; //#5
+    std::vector<uint64_t> codes;
+    std::vector<Node> nodes;
 
-            vec3f s = ray.origin - p0;
-            vec3f s2 = s.cross(e1);
+    // Length of the common prefix of the keys i and j, which are made
+    // unique by appending their indices to the codes
+    int delta(int i, int j) const
+    {
+      if (j < 0 || j >= int(codes.size()))
+        return -1;
+      if (codes[i] == codes[j])
+        return 64 + countLeadingZeros(uint64_t(i ^ j)) - 32;
+      return countLeadingZeros(codes[i] ^ codes[j]);
+    }
 
-            auto t = s2.dot(e2) * invD;
-            if (!isgreaterequal(t, 0.0f)) continue;
-            if ((distance = t * d) > hit.distance) continue;
+    void makeNode(int i)
+    {
+      // Direction of the range of the node
+      auto d = delta(i, i + 1) - delta(i, i - 1) > 0 ? 1 : -1;
+      auto deltaMin = delta(i, i - d);
+      int lMax = 2;
 
-            auto b1 = s1.dot(s) * invD;
-            if (!isgreaterequal(b1, 0.0f)) continue;
+      while (delta(i, i + lMax * d) > deltaMin)
+        lMax *= 2;
 
-            auto b2 = s2.dot(ray.direction) * invD;
-            if (!isgreaterequal(b2, 0.0f)) continue;
+      // Other end of the range
+      int l = 0;
 
-            if (b1 + b2 <= 1.0f)
-            {
-              hit.distance = distance;
-              hit.triangleIndex = _triangles[i];
-              hit.p = vec3f{ 1 - b1 - b2, b1, b2 };
-              intersect = true;
-            }
-          }
+      for (auto t = lMax / 2; t >= 1; t /= 2)
+        if (delta(i, i + (l + t) * d) > deltaMin)
+          l += t;
 
-        }
+      auto j = i + l * d;
+      auto deltaNode = delta(i, j);
+
+      // Split position
+      int s = 0;
+
+      for (int div = 2, t = l; t > 1; div *= 2)
+      {
+        t = (l + div - 1) / div;
+        if (delta(i, i + (s + t) * d) > deltaNode)
+          s += t;
       }
 
+      auto gamma = i + s * d + std::min(d, 0);
+      auto& node = nodes[i];
+
+      node.first = std::min(i, j);
+      node.last = std::max(i, j);
+      node.left = node.first == gamma ? ~gamma : gamma;
+      node.right = node.last == gamma + 1 ? ~(gamma + 1) : gamma + 1;
     }
-    return intersect;
 
+  }; // BVH::LBVH
+
+  BVH::Node*
+    BVH::makeLBVH(TriangleInfoArray& triangleInfo,
+      TriangleIndexArray& orderedTris)
+  {
+    const auto n = int(triangleInfo.size());
+
+    if (n == 1)
+      return makeLeaf(triangleInfo, 0, 1, orderedTris);
+
+    Bounds3f bounds;
+    Bounds3f centroidBounds;
+
+    computeBounds(triangleInfo, 0, n, bounds, centroidBounds);
+
+    // 30-bit codes sort in half the passes of 63-bit ones and are
+    // precise enough for small meshes
+    const auto bits = n <= (1 << 20) ? 10 : 21;
+    const auto& min = centroidBounds.min();
+    auto size = centroidBounds.size();
+    LBVH lbvh;
+    std::vector<int> index(n);
+
+    for (int i = 0; i < 3; ++i)
+      size[i] = size[i] > 0 ? math::inverse(size[i]) : 0;
+    lbvh.codes.resize(n);
+    forEachChunk(0, n, [&](int, int s, int e)
+      {
+        for (int i = s; i < e; ++i)
+        {
+          auto p = (triangleInfo[i].centroid - min) * size;
+
+          lbvh.codes[i] = mortonCode(p, bits);
+          index[i] = i;
+        }
+      });
+    radixSort(lbvh.codes, index, 3 * bits);
+
+    // Reorder the triangle infos as the codes
+    TriangleInfoArray sorted(n);
+
+    forEachChunk(0, n, [&](int, int s, int e)
+      {
+        for (int i = s; i < e; ++i)
+          sorted[i] = triangleInfo[index[i]];
+      });
+    triangleInfo.swap(sorted);
+    // Every internal node is computed independently
+    lbvh.nodes.resize(n - 1);
+    forEachChunk(0, n - 1, [&](int, int s, int e)
+      {
+        for (int i = s; i < e; ++i)
+          lbvh.makeNode(i);
+      });
+    return makeLBVHNode(lbvh, triangleInfo, 0, orderedTris, 0);
+  }
+
+  BVH::Node*
+    BVH::makeLBVHNode(const LBVH& lbvh,
+      TriangleInfoArray& triangleInfo,
+      int node,
+      TriangleIndexArray& orderedTris,
+      int depth)
+  {
+    const auto& k = lbvh.nodes[node];
+    auto n = k.last - k.first + 1;
+
+    // Collapse small subtrees into leaves
+    if (n <= _maxTrisPerNode)
+      return makeLeaf(triangleInfo, k.first, k.last + 1, orderedTris);
+    // Clustered or duplicate codes can nest deeper than the traversal
+    // stacks; makeNode() splits such subtrees at the median
+    if (depth + medianDepth(n) >= maxDepth)
+      return makeNode(triangleInfo, k.first, k.last + 1, orderedTris, depth);
+
+    auto makeChild = [&](int c)
+    {
+      return c < 0 ?
+        makeLeaf(triangleInfo, ~c, ~c + 1, orderedTris) :
+        makeLBVHNode(lbvh, triangleInfo, c, orderedTris, depth + 1);
+    };
+    Node* children[2];
+
+    if (n >= parallelBuildSize)
+      ThreadPool::global().parallelFor(2, [&](int i, int)
+        {
+          children[i] = makeChild(i == 0 ? k.left : k.right);
+        });
+    else
+    {
+      children[0] = makeChild(k.left);
+      children[1] = makeChild(k.right);
+    }
+
+    // The highest bit in which the codes of the range differ is the
+    // split axis
+    auto diff = lbvh.codes[k.first] ^ lbvh.codes[k.last];
+    auto axis = diff == 0 ? 0 : 2 - (63 - countLeadingZeros(diff)) % 3;
+
+    return new Node{ children[0], children[1], axis };
+  }
+
+  float
+    BVH::computeSAHCost() const
+  {
+    if (_nodes.empty())
+      return 0;
+
+    auto area = _nodes[0].bounds.area();
+    auto cost = 0.0f;
+
+    if (area <= 0)
+      return float(_triangles.size());
+    iterate([&cost](const BVHNodeInfo& node)
+      {
+        auto c = node.isLeaf ? float(node.numberOfTriangles) : sahTraversalCost;
+        cost += c * node.bounds.area();
+      });
+    return cost / area;
+  }
+
+  BVH::BVH(TriangleMesh& mesh, int maxTrisPerNode, SplitMethod splitMethod) :
+    _mesh{ &mesh },
+    _maxTrisPerNode{ maxTrisPerNode },
+    _splitMethod{ splitMethod },
+    _meshVersion{ mesh.version() },
+    _topologyHash{ topologyHash(mesh) }
+  {
+    PROFILE_ZONE("BVH::build");
+
+    const auto& data = mesh.data();
+    int nt{ data.numberOfTriangles };
+
+    if (nt == 0)
+      return;
+    _triangles.resize(nt);
+
+    TriangleInfoArray triangleInfo(nt);
+
+    forEachChunk(0, nt, [&](int, int s, int e)
+      {
+        for (int i = s; i < e; ++i)
+        {
+          _triangles[i] = i;
+
+          auto t = data.triangles + i;
+          Bounds3f b;
+
+          b.inflate(data.vertices[t->v[0]]);
+          b.inflate(data.vertices[t->v[1]]);
+          b.inflate(data.vertices[t->v[2]]);
+          triangleInfo[i] = { i, b };
+        }
+      });
+
+    TriangleIndexArray orderedTris(nt);
+    auto root = _splitMethod == SplitMethod::LBVH ?
+      makeLBVH(triangleInfo, orderedTris) :
+      makeNode(triangleInfo, 0, nt, orderedTris, 0);
+
+    _triangles.swap(orderedTris);
+    flatten(root);
+    delete root;
+    finishBuild();
+#ifdef _DEBUG
+    if (true)
+    {
+      mesh.bounds().print("Mesh bounds:");
+      printf("Mesh triangles: %d\n", nt);
+      bounds().print("BVH bounds:");
+      printf("BVH nodes: %d\n", _nodeCount);
+      printf("BVH SAH cost: %g\n", _sahCost);
+      iterate([this](const BVHNodeInfo& node)
+        {
+          if (!node.isLeaf)
+            return;
+          node.bounds.print("Leaf bounds:");
+          printf("Leaf triangles: %d\n", node.numberOfTriangles);
+          //for (int i = 0; i < node.numberOfTriangles; ++i)
+            //printf("%d ", _triangles[node.firstTriangleIndex + i]);
+          //putchar('\n');
+        });
+      putchar('\n');
+    }
+#endif // _DEBUG
+  }
+
+  BVH::~BVH()
+  {
+    // do nothing
+  }
+
+  void
+    BVH::finishBuild()
+  {
+    _nodeCount = int(_nodes.size());
+#ifdef BVH_SIMD
+    auto nt = int(_triangles.size());
+
+    _wideNodes.reserve(_nodeCount / 2 + 1);
+    _blocks.reserve((nt + 3) / 4 + _nodeCount / 2 + 1);
+    _leafBlocks.resize(_nodes.size());
+    collapse(0);
+#endif // BVH_SIMD
+    _buildSAHCost = _sahCost = computeSAHCost();
+  }
+
+  // Layout of a cached tree: the header, the flattened nodes, the
+  // triangle indices in leaf order, and the hash of nodes and indices
+  struct BVH::CacheHeader
+  {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    int32_t maxTrisPerNode;
+    int32_t splitMethod;
+    int32_t numberOfTriangles;
+    int32_t numberOfNodes;
+
+  }; // BVH::CacheHeader
+
+  BVH::BVH(TriangleMesh& mesh, const CacheHeader& header) :
+    _mesh{ &mesh },
+    _maxTrisPerNode{ header.maxTrisPerNode },
+    _splitMethod{ SplitMethod(header.splitMethod) },
+    _meshVersion{ mesh.version() },
+    _topologyHash{ topologyHash(mesh) }
+  {
+    // do nothing
+  }
+
+  constexpr char cacheMagic[4]{ 'B', 'V', 'H', 'C' };
+  constexpr uint32_t cacheVersion = 1;
+
+  // 64-bit FNV-1a over 8-byte words, then the remaining bytes
+  inline void
+    hashBuffer(uint64_t& h, const void* data, size_t size)
+  {
+    constexpr auto prime = 0x100000001b3ull;
+    auto p = (const char*)data;
+
+    for (; size >= 8; p += 8, size -= 8)
+    {
+      uint64_t w;
+
+      memcpy(&w, p, 8);
+      h = (h ^ w) * prime;
+    }
+    for (; size > 0; ++p, --size)
+      h = (h ^ uint8_t(*p)) * prime;
+  }
+
+  uint64_t
+    BVH::cacheKey(const TriangleMesh& mesh,
+      int maxTrisPerNode,
+      SplitMethod splitMethod)
+  {
+    const auto& data = mesh.data();
+    int32_t params[]
+    {
+      data.numberOfVertices,
+      data.numberOfTriangles,
+      maxTrisPerNode,
+      int32_t(splitMethod)
+    };
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    hashBuffer(h, &cacheVersion, sizeof cacheVersion);
+    hashBuffer(h, params, sizeof params);
+    hashBuffer(h, data.vertices, data.numberOfVertices * sizeof(vec3f));
+    hashBuffer(h,
+      data.triangles,
+      data.numberOfTriangles * sizeof(TriangleMesh::Triangle));
+    return h;
+  }
+
+  // Hash of the vertex indices of the mesh triangles. Chunks are hashed
+  // in parallel and their hashes combined in order
+  uint64_t
+    BVH::topologyHash(const TriangleMesh& mesh)
+  {
+    const auto& data = mesh.data();
+    const auto nt = data.numberOfTriangles;
+    std::vector<uint64_t> partial(numberOfChunks(nt));
+
+    forEachChunk(0, nt, [&](int chunk, int s, int e)
+      {
+        uint64_t h = 0xcbf29ce484222325ull;
+
+        hashBuffer(h,
+          data.triangles + s,
+          (e - s) * sizeof(TriangleMesh::Triangle));
+        partial[chunk] = h;
+      });
+
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    hashBuffer(h, &nt, sizeof nt);
+    hashBuffer(h, partial.data(), partial.size() * sizeof(uint64_t));
+    return h;
+  }
+
+  bool
+    BVH::save(const char* filename) const
+  {
+    auto file = std::fopen(filename, "wb");
+
+    if (file == nullptr)
+      return false;
+
+    CacheHeader header
+    {
+      { cacheMagic[0], cacheMagic[1], cacheMagic[2], cacheMagic[3] },
+      cacheVersion,
+      cacheKey(*_mesh, _maxTrisPerNode, _splitMethod),
+      _maxTrisPerNode,
+      int32_t(_splitMethod),
+      int32_t(_triangles.size()),
+      _nodeCount
+    };
+    uint64_t checksum = 0xcbf29ce484222325ull;
+
+    hashBuffer(checksum, _nodes.data(), _nodes.size() * sizeof(LinearNode));
+    hashBuffer(checksum, _triangles.data(), _triangles.size() * sizeof(int));
+
+    auto ok = fwrite(&header, sizeof header, 1, file) == 1 &&
+      fwrite(_nodes.data(), sizeof(LinearNode), _nodes.size(), file) ==
+      _nodes.size() &&
+      fwrite(_triangles.data(), sizeof(int), _triangles.size(), file) ==
+      _triangles.size() &&
+      fwrite(&checksum, sizeof checksum, 1, file) == 1;
+
+    ok = fclose(file) == 0 && ok;
+    // Never leave a truncated tree behind
+    if (!ok)
+      remove(filename);
+    return ok;
+  }
+
+  bool
+    BVH::isValid() const
+  {
+    const auto nt = int(_triangles.size());
+    // Children follow their parent, so depths are set before use
+    std::vector<int> depth(_nodeCount);
+
+    for (int i = 0; i < _nodeCount; ++i)
+    {
+      const auto& node = _nodes[i];
+
+      if (node.isLeaf())
+      {
+        if (node.offset < 0 || node.offset + node.count > nt)
+          return false;
+      }
+      else if (node.offset <= i + 1 || node.offset >= _nodeCount)
+        return false;
+      // A tree deeper than the traversal stacks would overflow them
+      else if (depth[i] >= maxDepth)
+        return false;
+      else
+        depth[i + 1] = depth[node.offset] = depth[i] + 1;
+    }
+    for (auto t : _triangles)
+      if (t < 0 || t >= nt)
+        return false;
+    return true;
+  }
+
+  BVH*
+    BVH::load(TriangleMesh& mesh,
+      const char* filename,
+      int maxTrisPerNode,
+      SplitMethod splitMethod)
+  {
+    static_assert(sizeof(CacheHeader) % alignof(LinearNode) == 0,
+      "BVH cache nodes must be aligned");
+    PROFILE_ZONE("BVH::load");
+
+    MappedFile file{ filename };
+
+    if (file.size() < sizeof(CacheHeader))
+      return nullptr;
+
+    auto header = (const CacheHeader*)file.data();
+    const auto nt = mesh.data().numberOfTriangles;
+    const auto nn = header->numberOfNodes;
+
+    if (memcmp(header->magic, cacheMagic, sizeof cacheMagic) != 0 ||
+      header->version != cacheVersion ||
+      header->maxTrisPerNode != maxTrisPerNode ||
+      header->splitMethod != int32_t(splitMethod) ||
+      header->numberOfTriangles != nt ||
+      nt == 0 ||
+      nn <= 0 ||
+      file.size() != sizeof(CacheHeader) +
+      nn * sizeof(LinearNode) + nt * sizeof(int) + sizeof(uint64_t))
+      return nullptr;
+    // A stale tree has the same size as the current one, so the content
+    // of the mesh must be checked as well
+    if (header->key != cacheKey(mesh, maxTrisPerNode, splitMethod))
+      return nullptr;
+
+    auto nodes = (const LinearNode*)(header + 1);
+    auto triangles = (const int*)(nodes + nn);
+    uint64_t checksum = 0xcbf29ce484222325ull;
+    uint64_t savedChecksum;
+
+    hashBuffer(checksum, nodes, nn * sizeof(LinearNode));
+    hashBuffer(checksum, triangles, nt * sizeof(int));
+    memcpy(&savedChecksum, triangles + nt, sizeof savedChecksum);
+    if (checksum != savedChecksum)
+      return nullptr;
+
+    auto bvh = new BVH{ mesh, *header };
+
+    bvh->_nodes.assign(nodes, nodes + nn);
+    bvh->_triangles.assign(triangles, triangles + nt);
+    bvh->_nodeCount = nn;
+    if (!bvh->isValid())
+    {
+      delete bvh;
+      return nullptr;
+    }
+    bvh->finishBuild();
+    return bvh;
+  }
+
+  bool
+    BVH::refit(float maxCostRatio)
+  {
+    PROFILE_ZONE("BVH::refit");
+
+    const auto& data = _mesh->data();
+
+    // The leaves index the triangles, so new triangles or vertex
+    // indices need a new tree
+    if (data.numberOfTriangles != int(_triangles.size()) ||
+      topologyHash(*_mesh) != _topologyHash)
+      return false;
+    _meshVersion = _mesh->version();
+    if (_nodes.empty())
+      return true;
+    // Leaves do not share triangles, so they are refitted in parallel
+    forEachChunk(0, _nodeCount, [&](int, int s, int e)
+      {
+        for (int i = s; i < e; ++i)
+        {
+          auto& node = _nodes[i];
+
+          if (!node.isLeaf())
+            continue;
+
+          Bounds3f bounds;
+
+          for (int j = node.offset, end = j + node.count; j < end; ++j)
+          {
+            auto t = data.triangles + _triangles[j];
+
+            bounds.inflate(data.vertices[t->v[0]]);
+            bounds.inflate(data.vertices[t->v[1]]);
+            bounds.inflate(data.vertices[t->v[2]]);
+          }
+          node.bounds = bounds;
+#ifdef BVH_SIMD
+          fillBlocks(_leafBlocks[i], node.offset, node.count);
+#endif // BVH_SIMD
+        }
+      });
+    // Children follow their parent in the flattened tree
+    for (auto i = _nodeCount; i-- > 0;)
+    {
+      auto& node = _nodes[i];
+
+      if (node.isLeaf())
+        continue;
+
+      Bounds3f bounds;
+
+      bounds.inflate(_nodes[i + 1].bounds);
+      bounds.inflate(_nodes[node.offset].bounds);
+      node.bounds = bounds;
+    }
+#ifdef BVH_SIMD
+    for (int w = 0, n = int(_wideNodes.size()); w < n; ++w)
+    {
+      auto& node = _wideNodes[w];
+
+      for (int i = 0; i < 4; ++i)
+      {
+        auto c = _wideSources[4 * w + i];
+
+        if (c < 0)
+          continue;
+
+        const auto& p1 = _nodes[c].bounds.min();
+        const auto& p2 = _nodes[c].bounds.max();
+
+        node.minX[i] = p1.x;
+        node.minY[i] = p1.y;
+        node.minZ[i] = p1.z;
+        node.maxX[i] = p2.x;
+        node.maxY[i] = p2.y;
+        node.maxZ[i] = p2.z;
+      }
+    }
+#endif // BVH_SIMD
+    _sahCost = computeSAHCost();
+    return _sahCost <= maxCostRatio * _buildSAHCost;
+  }
+
+  Bounds3f
+    BVH::bounds() const
+  {
+    return _nodes.empty() ? Bounds3f{} : _nodes[0].bounds;
+  }
+
+  void
+    BVH::iterate(BVHNodeFunction f) const
+  {
+    if (!_nodes.empty())
+      iterate(0, f);
+  }
+
+  inline bool
+    BVH::intersectLeaf(int first,
+      int count,
+      const Ray& ray,
+      Intersection& hit,
+      float d,
+      bool anyHit) const
+  {
+    const auto& data = _mesh->data();
+    auto triangles = data.triangles;
+    auto vertexArray = data.vertices;
+    bool intersect = false;
+
+    RT_COUNT(triangleTests, count);
+    for (int i = first, e = first + count; i < e; i++)
+    {
+      auto distance = math::Limits<float>::inf();
+      auto p0 = vertexArray[triangles[_triangles[i]].v[0]];
+      auto p1 = vertexArray[triangles[_triangles[i]].v[1]];
+      auto p2 = vertexArray[triangles[_triangles[i]].v[2]];
+
+      vec3f e1 = p1 - p0;// #1
+      vec3f e2 = p2 - p0;// #2
+      vec3f s1 = ray.direction.cross(e2);// #3
+
+      auto s1_e1 = s1.dot(e1);
+
+      if (math::isZero(abs(s1_e1))) continue; //#4
+
+      auto invD = math::inverse(s1_e1);
+      if (math::isZero(abs(invD))) continue; //#5
+
+      vec3f s = ray.origin - p0;
+      vec3f s2 = s.cross(e1);
+
+      auto t = s2.dot(e2) * invD;
+      if (!std::isgreaterequal(t, 0.0f)) continue;
+      if ((distance = t * d) > hit.distance) continue;
+
+      auto b1 = s1.dot(s) * invD;
+      if (!std::isgreaterequal(b1, 0.0f)) continue;
+
+      auto b2 = s2.dot(ray.direction) * invD;
+      if (!std::isgreaterequal(b2, 0.0f)) continue;
+
+      if (b1 + b2 <= 1.0f)
+      {
+        if (anyHit)
+          return true;
+        hit.distance = distance;
+        hit.triangleIndex = _triangles[i];
+        hit.p = vec3f{ 1 - b1 - b2, b1, b2 };
+        intersect = true;
+      }
+    }
+    return intersect;
+  }
+
+  bool
+    BVH::intersect(const Ray& ray, Intersection& hit, float d) const
+  {
+    if (_nodes.empty())
+      return false;
+#ifdef BVH_SIMD
+    return intersectWide(ray, hit, d);
+#else
+    const int dirIsNeg[3]{ ray.direction.x < 0,
+      ray.direction.y < 0,
+      ray.direction.z < 0 };
+    int stack[maxStackSize];
+    int top = 0;
+    int current = 0;
+    bool intersect = false;
+    float tMin, tMax;
+
+    for (;;)
+    {
+      const auto& node = _nodes[current];
+
+      RT_COUNT(nodesVisited, 1);
+      RT_COUNT(boxTests, 1);
+      // Skip the node if it is missed or farther than the best hit
+      if (!node.bounds.intersect(ray, tMin, tMax) ||
+        tMax < 0 ||
+        tMin * d > hit.distance)
+      {
+        if (top == 0)
+          break;
+        current = stack[--top];
+        continue;
+      }
+      if (!node.isLeaf())
+      {
+        // Visit the near child first
+        if (dirIsNeg[node.axis])
+        {
+          stack[top++] = current + 1;
+          current = node.offset;
+        }
+        else
+        {
+          stack[top++] = node.offset;
+          current = current + 1;
+        }
+        continue;
+      }
+      if (intersectLeaf(node.offset, node.count, ray, hit, d))
+        intersect = true;
+      if (top == 0)
+        break;
+      current = stack[--top];
+    }
+    return intersect;
+#endif // BVH_SIMD
+  }
+
+  bool
+    BVH::occluded(const Ray& ray, float d, float tMax) const
+  {
+    if (_nodes.empty())
+      return false;
+#ifdef BVH_SIMD
+    return occludedWide(ray, d, tMax);
+#else
+    Intersection hit;
+    int stack[maxStackSize];
+    int top = 0;
+    float tMin, tFar;
+
+    // Only hit.distance is read by the any-hit leaf test
+    hit.distance = tMax;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+      auto current = stack[--top];
+      const auto& node = _nodes[current];
+
+      RT_COUNT(nodesVisited, 1);
+      RT_COUNT(boxTests, 1);
+      if (!node.bounds.intersect(ray, tMin, tFar) ||
+        tFar < 0 ||
+        tMin * d > tMax)
+        continue;
+      if (!node.isLeaf())
+      {
+        stack[top++] = node.offset;
+        stack[top++] = current + 1;
+      }
+      else if (intersectLeaf(node.offset, node.count, ray, hit, d, true))
+        return true;
+    }
+    return false;
+#endif // BVH_SIMD
+  }
+
+#ifdef BVH_SIMD
+  // Ray with precomputed reciprocal direction and direction signs,
+  // replicated in SIMD registers
+  struct BVH::SlabRay
+  {
+    __m128 o[3];
+    __m128 dir[3];
+    __m128 invDir[3];
+    int dirIsNeg[3];
+
+    SlabRay(const Ray& ray)
+    {
+      for (int i = 0; i < 3; ++i)
+      {
+        auto invDir = math::inverse(ray.direction[i]);
+
+        o[i] = _mm_set1_ps(ray.origin[i]);
+        dir[i] = _mm_set1_ps(ray.direction[i]);
+        this->invDir[i] = _mm_set1_ps(invDir);
+        // The sign of the reciprocal handles -0 directions
+        dirIsNeg[i] = invDir < 0;
+      }
+    }
+
+  }; // SlabRay
+
+  inline __m128
+  cross(const __m128 a[3], const __m128 b[3], int i)
+  {
+    auto j = (i + 1) % 3;
+    auto k = (i + 2) % 3;
+
+    return _mm_sub_ps(_mm_mul_ps(a[j], b[k]), _mm_mul_ps(a[k], b[j]));
+  }
+
+  inline __m128
+  dot(const __m128 a[3], const __m128 b[3])
+  {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]),
+      _mm_mul_ps(a[1], b[1])),
+      _mm_mul_ps(a[2], b[2]));
+  }
+
+  bool
+    BVH::intersectBlocks(int first,
+      int count,
+      const SlabRay& ray,
+      Intersection& hit,
+      float d,
+      bool anyHit) const
+  {
+    // Same operations, in the same order, as the scalar Moller-Trumbore
+    // test in intersectLeaf(), applied to four triangles at once
+    const auto zero = _mm_setzero_ps();
+    const auto one = _mm_set1_ps(1);
+    const auto eps = _mm_set1_ps(math::Limits<float>::eps());
+    const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const auto vd = _mm_set1_ps(d);
+    bool intersect = false;
+
+    for (auto e = first + (count + 3) / 4; first < e; ++first)
+    {
+      const auto& block = _blocks[first];
+      __m128 e1[3], e2[3], s[3];
+
+      RT_COUNT(triangleTests, 4);
+
+      for (int i = 0; i < 3; ++i)
+      {
+        e1[i] = _mm_load_ps(block.e1[i]);
+        e2[i] = _mm_load_ps(block.e2[i]);
+        s[i] = _mm_sub_ps(ray.o[i], _mm_load_ps(block.v0[i]));
+      }
+
+      const __m128 s1[3]{ cross(ray.dir, e2, 0),
+        cross(ray.dir, e2, 1),
+        cross(ray.dir, e2, 2) };
+      auto s1_e1 = dot(s1, e1);
+      auto mask = _mm_cmpnle_ps(_mm_and_ps(s1_e1, absMask), eps);
+      auto invD = _mm_div_ps(one, s1_e1);
+
+      mask = _mm_and_ps(mask,
+        _mm_cmpnle_ps(_mm_and_ps(invD, absMask), eps));
+
+      const __m128 s2[3]{ cross(s, e1, 0),
+        cross(s, e1, 1),
+        cross(s, e1, 2) };
+      auto t = _mm_mul_ps(dot(s2, e2), invD);
+      auto distance = _mm_mul_ps(t, vd);
+      auto b1 = _mm_mul_ps(dot(s1, s), invD);
+      auto b2 = _mm_mul_ps(dot(s2, ray.dir), invD);
+
+      mask = _mm_and_ps(mask, _mm_cmpge_ps(t, zero));
+      mask = _mm_and_ps(mask,
+        _mm_cmple_ps(distance, _mm_set1_ps(hit.distance)));
+      mask = _mm_and_ps(mask, _mm_cmpge_ps(b1, zero));
+      mask = _mm_and_ps(mask, _mm_cmpge_ps(b2, zero));
+      mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(b1, b2), one));
+
+      auto bits = _mm_movemask_ps(mask);
+
+      if (bits == 0)
+        continue;
+      if (anyHit)
+        return true;
+
+      alignas(16) float vDistance[4], vB1[4], vB2[4];
+
+      _mm_store_ps(vDistance, distance);
+      _mm_store_ps(vB1, b1);
+      _mm_store_ps(vB2, b2);
+      // Lanes are taken in triangle order, as the scalar test does
+      for (int i = 0; i < 4; ++i)
+        if ((bits & (1 << i)) != 0 && vDistance[i] <= hit.distance)
+        {
+          hit.distance = vDistance[i];
+          hit.triangleIndex = block.index[i];
+          hit.p = vec3f{ 1 - vB1[i] - vB2[i], vB1[i], vB2[i] };
+          intersect = true;
+        }
+    }
+    return intersect;
+  }
+
+  bool
+    BVH::intersectWide(const Ray& ray, Intersection& hit, float d) const
+  {
+    struct Entry
+    {
+      int node;
+      float tMin;
+
+    } stack[3 * maxStackSize];
+    const SlabRay r{ ray };
+    const auto invD = math::inverse(d);
+    int top = 0;
+    bool intersect = false;
+
+    stack[top++] = { 0, 0 };
+    while (top > 0)
+    {
+      auto entry = stack[--top];
+
+      // Skip the node if it is farther than the best hit
+      if (entry.tMin * d > hit.distance)
+        continue;
+
+      const auto& node = _wideNodes[entry.node];
+
+      RT_COUNT(nodesVisited, 1);
+      RT_COUNT(boxTests, 4);
+
+      const float* p[2][3]
+      {
+        { node.minX, node.minY, node.minZ },
+        { node.maxX, node.maxY, node.maxZ }
+      };
+      auto tMin = _mm_setzero_ps();
+      auto tMax = _mm_set1_ps(hit.distance * invD);
+
+      // Slab test of the four child boxes; NaNs (0 * inf) are dropped
+      // by keeping the running interval as the second operand
+      for (int i = 0; i < 3; ++i)
+      {
+        auto s = r.dirIsNeg[i];
+        auto t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p[s][i]), r.o[i]),
+          r.invDir[i]);
+        auto t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p[1 - s][i]), r.o[i]),
+          r.invDir[i]);
+
+        tMin = _mm_max_ps(t0, tMin);
+        tMax = _mm_min_ps(t1, tMax);
+      }
+
+      auto mask = _mm_movemask_ps(_mm_cmple_ps(tMin, tMax));
+
+      if (mask == 0)
+        continue;
+
+      // Sort the hit children by entry distance
+      alignas(16) float t[4];
+      Entry hits[4];
+      int n = 0;
+
+      _mm_store_ps(t, tMin);
+      for (int i = 0; i < 4; ++i)
+      {
+        if ((mask & (1 << i)) == 0 || node.child[i] < 0)
+          continue;
+
+        auto k = n++;
+
+        for (; k > 0 && hits[k - 1].tMin > t[i]; --k)
+          hits[k] = hits[k - 1];
+        hits[k] = { i, t[i] };
+      }
+      // Intersect leaves near to far, then push interior nodes far to
+      // near so that the nearest one is popped first
+      for (int k = 0; k < n; ++k)
+      {
+        auto i = hits[k].node;
+
+        if (node.count[i] > 0 && hits[k].tMin * d <= hit.distance)
+          if (intersectBlocks(node.child[i], node.count[i], r, hit, d))
+            intersect = true;
+      }
+      for (int k = n; k-- > 0;)
+      {
+        auto i = hits[k].node;
+
+        if (node.count[i] == 0)
+          stack[top++] = { node.child[i], hits[k].tMin };
+      }
+    }
+    return intersect;
+  }
+  bool
+    BVH::occludedWide(const Ray& ray, float d, float tMax) const
+  {
+    // Any hit ends the query, so children are not sorted
+    const SlabRay r{ ray };
+    const auto tFar = _mm_set1_ps(tMax * math::inverse(d));
+    Intersection hit;
+    int stack[3 * maxStackSize];
+    int top = 0;
+
+    hit.distance = tMax;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+      const auto& node = _wideNodes[stack[--top]];
+
+      RT_COUNT(nodesVisited, 1);
+      RT_COUNT(boxTests, 4);
+
+      const float* p[2][3]
+      {
+        { node.minX, node.minY, node.minZ },
+        { node.maxX, node.maxY, node.maxZ }
+      };
+      auto tMin = _mm_setzero_ps();
+      auto tExit = tFar;
+
+      for (int i = 0; i < 3; ++i)
+      {
+        auto s = r.dirIsNeg[i];
+        auto t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p[s][i]), r.o[i]),
+          r.invDir[i]);
+        auto t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p[1 - s][i]), r.o[i]),
+          r.invDir[i]);
+
+        tMin = _mm_max_ps(t0, tMin);
+        tExit = _mm_min_ps(t1, tExit);
+      }
+
+      auto mask = _mm_movemask_ps(_mm_cmple_ps(tMin, tExit));
+
+      for (int i = 0; mask != 0; ++i, mask >>= 1)
+        if ((mask & 1) == 0 || node.child[i] < 0)
+          continue;
+        else if (node.count[i] == 0)
+          stack[top++] = node.child[i];
+        else if (intersectBlocks(node.child[i],
+          node.count[i],
+          r,
+          hit,
+          d,
+          true))
+          return true;
+    }
+    return false;
+  }
+#endif // BVH_SIMD
+
+  uint32_t
+    BVH::intersect(const RayPacket& packet,
+      Intersection hit[],
+      uint32_t mask) const
+  {
+    if (_nodes.empty())
+      return 0;
+
+    struct Entry
+    {
+      int node;
+      uint32_t mask;
+
+    } stack[maxStackSize];
+    int top = 0;
+    uint32_t result = 0;
+
+    stack[top++] = { 0, mask };
+    while (top > 0)
+    {
+      auto entry = stack[--top];
+      const auto& node = _nodes[entry.node];
+
+      RT_COUNT(nodesVisited, 1);
+      RT_COUNT(boxTests, bitCount(entry.mask));
+      // Cull the node for the whole packet, then ray by ray. Once the
+      // packet has diverged to a single ray, this is a plain traversal
+      if ((entry.mask & (entry.mask - 1)) != 0 &&
+        packet.misses(node.bounds))
+        continue;
+
+      auto active = packet.intersect(node.bounds, hit, entry.mask);
+
+      if (active == 0)
+        continue;
+      if (!node.isLeaf())
+      {
+        // All rays have the same direction signs: visit the near child
+        // first
+        auto first = entry.node + 1;
+        auto second = node.offset;
+
+        if (packet.dirIsNeg[node.axis])
+          std::swap(first, second);
+        stack[top++] = { second, active };
+        stack[top++] = { first, active };
+        continue;
+      }
+      for (int k = 0; k < RayPacket::size; ++k)
+      {
+        if ((active & (1u << k)) == 0)
+          continue;
+#ifdef BVH_SIMD
+        if (intersectBlocks(_leafBlocks[entry.node],
+          node.count,
+          SlabRay{ packet.rays[k] },
+          hit[k],
+          packet.d[k]))
+#else
+        if (intersectLeaf(node.offset,
+          node.count,
+          packet.rays[k],
+          hit[k],
+          packet.d[k]))
+#endif // BVH_SIMD
+          result |= 1u << k;
+      }
+    }
+    return result;
   }
 
 } // end namespace cg
@@ -33,11 +33,16 @@
 #ifndef __BVH_h
 #define __BVH_h
 
-#include "graphics/GLMesh.h"
 #include "Intersection.h"
+#include "geometry/TriangleMesh.h"
 #include <functional>
 #include <vector>
 
+// 4-wide BVH traversal with SSE slab tests (always available on x64)
+#if defined(_M_X64) || defined(__SSE2__)
+#define BVH_SIMD
+#endif
+
 namespace cg
 { // begin namespace cg
 
@@ -52,35 +57,158 @@ struct BVHNodeInfo
 
 using BVHNodeFunction = std::function<void(const BVHNodeInfo&)>;
 
+struct RayPacket;
+
 class BVH: public SharedObject
 {
 public:
-  BVH(TriangleMesh& mesh, int maxTrisPerNode = 16);
+  enum class SplitMethod
+  {
+    Median, // split at the median centroid on the largest axis
+    SAH, // binned surface area heuristic
+    LBVH // linear BVH from sorted Morton codes (fastest build)
+  };
+
+  BVH(TriangleMesh& mesh,
+    int maxTrisPerNode = 16,
+    SplitMethod splitMethod = SplitMethod::Median);
 
   ~BVH() override;
 
+  // Hash of the vertices and triangles of mesh and of the build
+  // parameters, which identifies a cached tree
+  static uint64_t cacheKey(const TriangleMesh& mesh,
+    int maxTrisPerNode,
+    SplitMethod splitMethod);
+
+  // Loads from filename (memory-mapped) a tree saved by save(). Returns
+  // nullptr if the file does not exist, is corrupt, or was not saved
+  // for the current content of mesh and the same build parameters
+  static BVH* load(TriangleMesh& mesh,
+    const char* filename,
+    int maxTrisPerNode = 16,
+    SplitMethod splitMethod = SplitMethod::Median);
+
+  // Writes the flattened tree and triangle order to filename
+  bool save(const char* filename) const;
+
   const TriangleMesh* mesh() const
   {
     return _mesh;
   }
 
+  auto splitMethod() const
+  {
+    return _splitMethod;
+  }
+
+  // SAH cost of the tree (traversal and intersection costs of a ray
+  // hitting the root bounds), to compare builders
+  auto sahCost() const
+  {
+    return _sahCost;
+  }
+
+  // Version of the mesh vertices the tree was built or refitted for
+  auto meshVersion() const
+  {
+    return _meshVersion;
+  }
+
+  // Recomputes the bounds of the nodes bottom-up after the mesh vertices
+  // changed, keeping the topology of the tree. Returns false if the tree
+  // should be rebuilt instead: when the mesh triangles changed or when
+  // the SAH cost grew above maxCostRatio times the one of the last build
+  bool refit(float maxCostRatio = 2);
+
   Bounds3f bounds() const;
   void iterate(BVHNodeFunction f) const;
 
   bool intersect(const Ray& ray, Intersection& hit, float d) const;
 
+  // Returns true if the ray hits any triangle closer than tMax, where
+  // t * d is the distance of the point at t along the (local) ray
+  bool occluded(const Ray& ray, float d, float tMax) const;
+
+  // Intersects the rays in mask of a coherent packet. Returns the mask
+  // of the rays whose hit was updated
+  uint32_t intersect(const RayPacket& packet,
+    Intersection hit[],
+    uint32_t mask) const;
+
 
 private:
   struct Node;
+  struct CacheHeader;
+
+  // Constructs an empty tree to be loaded from a cache file
+  BVH(TriangleMesh& mesh, const CacheHeader& header);
+
+  // Node of the depth-first flattened tree. The first child of an
+  // interior node immediately follows it; offset is the index of the
+  // second child or, for a leaf, of its first triangle
+  struct alignas(32) LinearNode
+  {
+    Bounds3f bounds;
+    int offset;
+    uint16_t count; // number of triangles (0 for interior nodes)
+    uint8_t axis; // split axis of interior nodes
+    uint8_t pad{};
+
+    bool isLeaf() const
+    {
+      return count > 0;
+    }
+
+  }; // LinearNode
 
+  static_assert(sizeof(LinearNode) == 32, "BVH node must have 32 bytes");
+
+  // Node of the 4-wide BVH collapsed from the binary tree. Child boxes
+  // are stored in SoA form so that one SIMD slab test covers all of
+  // them. For each child, count > 0 means a leaf with count triangles
+  // whose first triangle block is child[i], count == 0 and child[i] >= 0
+  // an interior node, and child[i] < 0 an empty slot
+  struct alignas(64) WideNode
+  {
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+    int child[4];
+    int count[4];
+
+  }; // WideNode
+
+  // Vertex v0 and edges e1 and e2 of four leaf triangles in SoA form,
+  // precomputed for the SIMD ray/triangle test. Unused lanes hold
+  // degenerate triangles, which the test always rejects
+  struct alignas(16) TriangleBlock
+  {
+    float v0[3][4];
+    float e1[3][4];
+    float e2[3][4];
+    int index[4];
+
+  }; // TriangleBlock
 
   using TriangleIndexArray = std::vector<int>;
+  using NodeArray = std::vector<LinearNode>;
+  using WideNodeArray = std::vector<WideNode>;
+  using TriangleBlockArray = std::vector<TriangleBlock>;
 
   Reference<TriangleMesh> _mesh;
   TriangleIndexArray _triangles;
-  Node* _root{};
+  NodeArray _nodes;
+  WideNodeArray _wideNodes;
+  TriangleBlockArray _blocks;
+  TriangleIndexArray _leafBlocks; // first block of each binary leaf
+  TriangleIndexArray _wideSources; // binary node of each wide node slot
   int _nodeCount{};
   int _maxTrisPerNode;
+  SplitMethod _splitMethod;
+  float _sahCost{};
+  float _buildSAHCost{};
+  uint32_t _meshVersion;
+  uint64_t _topologyHash; // of the mesh triangles the tree was built for
 
   struct TriangleInfo;
 
@@ -94,8 +222,63 @@ private:
   Node* makeNode(TriangleInfoArray&,
     int start,
     int end,
-    TriangleIndexArray&);
-  
+    TriangleIndexArray&,
+    int depth);
+
+  void computeBounds(const TriangleInfoArray&,
+    int start,
+    int end,
+    Bounds3f& bounds,
+    Bounds3f& centroidBounds) const;
+
+  int splitMedian(TriangleInfoArray&, int start, int end, int dim);
+
+  struct LBVH;
+
+  Node* makeLBVH(TriangleInfoArray&, TriangleIndexArray&);
+  Node* makeLBVHNode(const LBVH&,
+    TriangleInfoArray&,
+    int node,
+    TriangleIndexArray&,
+    int depth);
+
+  int splitSAH(TriangleInfoArray&,
+    int start,
+    int end,
+    const Bounds3f& bounds,
+    const Bounds3f& centroidBounds,
+    int& dim);
+
+  int flatten(const Node*);
+  int collapse(int);
+  int makeBlocks(int first, int count);
+  void fillBlocks(int index, int first, int count);
+  void iterate(int, BVHNodeFunction&) const;
+
+  bool intersectLeaf(int first,
+    int count,
+    const Ray& ray,
+    Intersection& hit,
+    float d,
+    bool anyHit = false) const;
+
+  struct SlabRay;
+
+  bool intersectBlocks(int first,
+    int count,
+    const SlabRay& ray,
+    Intersection& hit,
+    float d,
+    bool anyHit = false) const;
+  bool intersectWide(const Ray&, Intersection&, float) const;
+  bool occludedWide(const Ray&, float, float) const;
+
+  float computeSAHCost() const;
+  void finishBuild();
+  bool isValid() const;
+
+  static uint64_t topologyHash(const TriangleMesh&);
+
 }; // BVH
 
 } // end namespace cg
@@ -0,0 +1,474 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: BenchMain.cpp
+// ========
+// Source file for p4-bench, the ray tracer benchmark.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#include "RayTracer.h"
+#include "Scenes.h"
+#include "core/ThreadPool.h"
+#include "geometry/MeshSweeper.h"
+#include "graphics/MemoryImage.h"
+#include "utils/MeshReader.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#define PATH_SEP '\\'
+#else
+#include <sys/resource.h>
+#define PATH_SEP '/'
+#endif
+
+using namespace cg;
+
+namespace
+{ // begin namespace
+
+struct Size
+{
+  int width;
+  int height;
+
+}; // Size
+
+struct Options
+{
+  std::vector<int> scenes{1, 2, 3, 4, 5};
+  std::vector<int> grids{8, 16, 32};
+  std::vector<Size> sizes{{640, 360}, {1280, 720}};
+  std::vector<int> threads{1, 0};
+  int repeat{3};
+  std::string assetDir;
+  std::string output{"bench.json"};
+  std::string baseline;
+  float threshold{0.05f};
+
+}; // Options
+
+struct Result
+{
+  std::string name;
+  int width;
+  int height;
+  int threads;
+  double seconds;
+  RayTracer::RayCounts rays;
+  double bvhBuildMs;
+  double peakMemoryMB;
+
+  double mrays(uint64_t count) const
+  {
+    return count * 1e-6 / seconds;
+  }
+
+}; // Result
+
+void
+usage(const char* program)
+{
+  fprintf(stderr,
+    "Usage: %s [options]\n"
+    "  --scenes list       example scenes to run (default 1,2,3,4,5)\n"
+    "  --grids list        n x n ball grids to run (default 8,16,32)\n"
+    "  --sizes list        image sizes (default 640x360,1280x720)\n"
+    "  --threads list      thread counts, 0 = all cores (default 1,0)\n"
+    "  --repeat n          renders per run, the fastest is kept (default 3)\n"
+    "  --assets dir        asset directory (default: assets/ next to %s)\n"
+    "  -o file             JSON results (default bench.json)\n"
+    "  --baseline file     JSON results to compare against\n"
+    "  --threshold t       fraction of the baseline Mrays/s below which a\n"
+    "                      run is a regression (default 0.05)\n",
+    program, program);
+  exit(EXIT_FAILURE);
+}
+
+// Parses a comma-separated list of integers. An empty list is allowed
+bool
+parseList(const char* s, std::vector<int>& list)
+{
+  list.clear();
+  while (*s)
+  {
+    char* end;
+
+    list.push_back((int)strtol(s, &end, 10));
+    if (end == s || (*end != ',' && *end != 0))
+      return false;
+    s = *end ? end + 1 : end;
+  }
+  return true;
+}
+
+bool
+parseSizes(const char* s, std::vector<Size>& sizes)
+{
+  sizes.clear();
+  for (int w, h, n; sscanf(s, "%dx%d%n", &w, &h, &n) == 2; s += n + 1)
+  {
+    if (w <= 0 || h <= 0)
+      return false;
+    sizes.push_back({w, h});
+    if (s[n] != ',')
+      return s[n] == 0;
+  }
+  return false;
+}
+
+bool
+parseOptions(int argc, char** argv, Options& options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    auto arg = argv[i];
+    auto next = [&]()
+    {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+      return argv[++i];
+    };
+    bool ok = true;
+
+    if (!strcmp(arg, "--scenes"))
+      ok = parseList(next(), options.scenes);
+    else if (!strcmp(arg, "--grids"))
+      ok = parseList(next(), options.grids);
+    else if (!strcmp(arg, "--sizes"))
+      ok = parseSizes(next(), options.sizes);
+    else if (!strcmp(arg, "--threads"))
+      ok = parseList(next(), options.threads);
+    else if (!strcmp(arg, "--repeat"))
+      ok = (options.repeat = atoi(next())) > 0;
+    else if (!strcmp(arg, "--assets"))
+    {
+      options.assetDir = next();
+      if (options.assetDir.back() != '/' && options.assetDir.back() != '\\')
+        options.assetDir += '/';
+    }
+    else if (!strcmp(arg, "-o"))
+      options.output = next();
+    else if (!strcmp(arg, "--baseline"))
+      options.baseline = next();
+    else if (!strcmp(arg, "--threshold"))
+      options.threshold = (float)atof(next());
+    else
+      ok = false;
+    if (!ok)
+      return false;
+  }
+  return !options.sizes.empty() && !options.threads.empty();
+}
+
+// Peak resident memory of the process so far, in MB
+double
+peakMemoryMB()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters))
+    return 0;
+  return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+  rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+  return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+inline auto
+elapsed(std::chrono::steady_clock::time_point start)
+{
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now() - start).count();
+}
+
+// Renders scene with every size and thread count of options
+void
+run(const char* name,
+  Scene& scene,
+  double bvhBuildMs,
+  const Options& options,
+  std::vector<Result>& results)
+{
+  auto camera = Camera::current();
+
+  for (const auto& size : options.sizes)
+    for (auto threads : options.threads)
+    {
+      RayTracer rayTracer{scene, camera};
+      MemoryImage image{size.width, size.height};
+      Result result;
+      char id[64];
+
+      snprintf(id, sizeof id, "%s/%dx%d/t%d",
+        name,
+        size.width,
+        size.height,
+        threads);
+      rayTracer.setImageSize(size.width, size.height);
+      rayTracer.setNumberOfThreads(threads);
+      result.name = id;
+      result.width = size.width;
+      result.height = size.height;
+      result.threads = ThreadPool::global().concurrency(threads);
+      result.seconds = 0;
+      for (int i = 0; i < options.repeat; ++i)
+      {
+        auto start = std::chrono::steady_clock::now();
+
+        rayTracer.renderImage(image);
+
+        auto time = elapsed(start);
+
+        if (i == 0 || time < result.seconds)
+          result.seconds = time;
+      }
+      result.rays = rayTracer.rayCounts();
+      result.bvhBuildMs = bvhBuildMs;
+      result.peakMemoryMB = peakMemoryMB();
+      fprintf(stderr,
+        "%-28s %8.3f s %8.2f Mrays/s"
+        " (primary %.2f, shadow %.2f, reflection %.2f)\n",
+        id,
+        result.seconds,
+        result.mrays(result.rays.total()),
+        result.mrays(result.rays.primary),
+        result.mrays(result.rays.shadow),
+        result.mrays(result.rays.reflection));
+      results.push_back(result);
+    }
+}
+
+// Writes one result per line, so that readBaseline() need not parse
+// arbitrary JSON
+bool
+writeResults(const char* filename, const std::vector<Result>& results)
+{
+  auto file = std::fopen(filename, "w");
+
+  if (file == nullptr)
+    return false;
+  fprintf(file, "{\n  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const auto& r = results[i];
+
+    fprintf(file,
+      "    {\"name\": \"%s\", \"width\": %d, \"height\": %d, "
+      "\"threads\": %d, \"seconds\": %.6f, "
+      "\"primaryRays\": %llu, \"shadowRays\": %llu, "
+      "\"reflectionRays\": %llu, \"mrays\": %.4f, "
+      "\"primaryMrays\": %.4f, \"shadowMrays\": %.4f, "
+      "\"reflectionMrays\": %.4f, \"bvhBuildMs\": %.3f, "
+      "\"peakMemoryMB\": %.1f}%s\n",
+      r.name.c_str(),
+      r.width,
+      r.height,
+      r.threads,
+      r.seconds,
+      (unsigned long long)r.rays.primary,
+      (unsigned long long)r.rays.shadow,
+      (unsigned long long)r.rays.reflection,
+      r.mrays(r.rays.total()),
+      r.mrays(r.rays.primary),
+      r.mrays(r.rays.shadow),
+      r.mrays(r.rays.reflection),
+      r.bvhBuildMs,
+      r.peakMemoryMB,
+      i + 1 < results.size() ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+  return fclose(file) == 0;
+}
+
+// Reads the total Mrays/s of each run of a file written by
+// writeResults()
+bool
+readBaseline(const char* filename, std::map<std::string, double>& mrays)
+{
+  auto file = std::fopen(filename, "r");
+
+  if (file == nullptr)
+    return false;
+  for (char line[1024]; fgets(line, sizeof line, file);)
+  {
+    auto name = strstr(line, "\"name\": \"");
+    auto value = strstr(line, "\"mrays\": ");
+
+    if (name == nullptr || value == nullptr)
+      continue;
+    name += 9;
+    if (auto end = strchr(name, '"'))
+      mrays[std::string{name, end}] = atof(value + 9);
+  }
+  fclose(file);
+  return true;
+}
+
+// Prints the runs slower than the baseline by more than threshold and
+// returns their number. Runs missing in the baseline are not compared
+int
+compare(const std::vector<Result>& results,
+  const std::map<std::string, double>& baseline,
+  float threshold)
+{
+  int regressions = 0;
+
+  printf("\n%-28s %10s %10s %8s\n", "Run", "Baseline", "Mrays/s", "Change");
+  for (const auto& r : results)
+  {
+    auto it = baseline.find(r.name);
+
+    if (it == baseline.end() || it->second <= 0)
+      continue;
+
+    auto mrays = r.mrays(r.rays.total());
+    auto change = mrays / it->second - 1;
+    auto regression = change < -threshold;
+
+    printf("%-28s %10.2f %10.2f %+7.1f%%%s\n",
+      r.name.c_str(),
+      it->second,
+      mrays,
+      100 * change,
+      regression ? "  REGRESSION" : "");
+    regressions += regression;
+  }
+  return regressions;
+}
+
+} // end namespace
+
+int
+main(int argc, char** argv)
+{
+  Options options;
+
+  if (!parseOptions(argc, argv, options))
+    usage(argv[0]);
+  if (options.assetDir.empty())
+  {
+    // Same default as the one of Application
+    if (const auto slash = strrchr(argv[0], PATH_SEP))
+      options.assetDir = std::string{argv[0], slash} + "/assets/";
+    else
+      options.assetDir = "./assets/";
+  }
+
+  std::map<std::string, double> baseline;
+
+  if (!options.baseline.empty() &&
+    !readBaseline(options.baseline.c_str(), baseline))
+  {
+    fprintf(stderr, "Unable to read %s\n", options.baseline.c_str());
+    return EXIT_FAILURE;
+  }
+
+  std::map<std::string, Reference<TriangleMesh>> meshes;
+  auto loadMesh = [&](const std::string& name) -> TriangleMesh*
+  {
+    auto& mesh = meshes[name];
+
+    if (mesh == nullptr)
+    {
+      if (name == "Box")
+        mesh = MeshSweeper::makeBox();
+      else if (name == "Sphere")
+        mesh = MeshSweeper::makeSphere();
+      else
+      {
+        auto filename = options.assetDir + "meshes/" + name;
+        mesh = MeshReader::read(filename.c_str());
+      }
+    }
+    return mesh;
+  };
+  std::vector<Result> results;
+  auto bench = [&](const char* name, Scene* scene)
+  {
+    if (scene == nullptr)
+    {
+      fprintf(stderr, "Skipping %s: no such scene\n", name);
+      return;
+    }
+
+    Reference<Scene> ref{scene};
+    // The BVHs are not cached, so that their build is timed
+    auto start = std::chrono::steady_clock::now();
+
+    makeBVHs(*scene, "");
+    run(name, *scene, 1000 * elapsed(start), options, results);
+  };
+  char name[32];
+
+  for (auto n : options.scenes)
+  {
+    snprintf(name, sizeof name, "scene%d", n);
+    bench(name, buildScene(n, loadMesh));
+  }
+  for (auto n : options.grids)
+  {
+    snprintf(name, sizeof name, "grid%d", n);
+    bench(name, n > 0 ? buildGridScene(n, loadMesh) : nullptr);
+  }
+  if (!writeResults(options.output.c_str(), results))
+  {
+    fprintf(stderr, "Unable to write %s\n", options.output.c_str());
+    return EXIT_FAILURE;
+  }
+  printf("\nResults written to %s\n", options.output.c_str());
+  if (baseline.empty())
+    return EXIT_SUCCESS;
+
+  auto regressions = compare(results, baseline, options.threshold);
+
+  if (regressions > 0)
+  {
+    printf("%d regression(s) above %.1f%%\n",
+      regressions,
+      100 * options.threshold);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
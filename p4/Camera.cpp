@@ -30,7 +30,7 @@
 // Author(s): Paulo Pagliosa (and your name)
 // Last revision: 21/09/2019
 
-#include "Camera.h"
+#include "SceneObject.h"
 
 namespace cg
 { // begin namespace cg
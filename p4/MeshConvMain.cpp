@@ -0,0 +1,140 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: MeshConvMain.cpp
+// ========
+// Source file for p4-meshconv, the OBJ to binary mesh converter.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#include "utils/MeshReader.h"
+#include "utils/MeshWriter.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+using namespace cg;
+
+namespace fs = std::filesystem;
+
+namespace
+{ // begin namespace
+
+void
+usage(const char* program)
+{
+  fprintf(stderr,
+    "Usage: %s [-f] path...\n"
+    "Converts OBJ files into binary mesh files (.mesh) next to them.\n"
+    "A directory path converts all the OBJ files in it.\n"
+    "  -f                  convert even if the binary file is up to date\n",
+    program);
+  exit(EXIT_FAILURE);
+}
+
+inline bool
+isUpToDate(const fs::path& obj, const fs::path& binary)
+{
+  std::error_code e1;
+  std::error_code e2;
+  auto binaryTime = fs::last_write_time(binary, e1);
+  auto time = fs::last_write_time(obj, e2);
+
+  return !e1 && !e2 && binaryTime >= time;
+}
+
+bool
+convert(const fs::path& obj, bool force)
+{
+  auto binary = fs::path{obj}.replace_extension(".mesh");
+
+  if (!force && isUpToDate(obj, binary))
+  {
+    printf("%s is up to date\n", binary.string().c_str());
+    return true;
+  }
+
+  using namespace std::chrono;
+  auto start = steady_clock::now();
+  Reference<TriangleMesh> mesh{MeshReader::readOBJ(obj.string().c_str())};
+
+  if (mesh == nullptr)
+  {
+    fprintf(stderr, "Unable to read %s\n", obj.string().c_str());
+    return false;
+  }
+  if (!MeshWriter::writeBinary(binary.string().c_str(), *mesh))
+  {
+    fprintf(stderr, "Unable to write %s\n", binary.string().c_str());
+    return false;
+  }
+
+  const auto& data = mesh->data();
+
+  printf("%s: %d vertices, %d triangles, %.1f MB -> %.1f MB in %.3f s\n",
+    binary.string().c_str(),
+    data.numberOfVertices,
+    data.numberOfTriangles,
+    fs::file_size(obj) / 1048576.0,
+    fs::file_size(binary) / 1048576.0,
+    duration<double>(steady_clock::now() - start).count());
+  return true;
+}
+
+} // end namespace
+
+int
+main(int argc, char** argv)
+{
+  std::vector<fs::path> files;
+  bool force{};
+
+  for (int i = 1; i < argc; ++i)
+    if (!strcmp(argv[i], "-f"))
+      force = true;
+    else if (argv[i][0] == '-')
+      usage(argv[0]);
+    else if (fs::is_directory(argv[i]))
+    {
+      for (const auto& e : fs::directory_iterator(argv[i]))
+        if (e.is_regular_file() && e.path().extension() == ".obj")
+          files.push_back(e.path());
+    }
+    else
+      files.push_back(argv[i]);
+  if (files.empty())
+    usage(argv[0]);
+
+  int failures{};
+
+  for (const auto& file : files)
+    if (!convert(file, force))
+      failures++;
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
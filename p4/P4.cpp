@@ -1,5 +1,7 @@
 #include "geometry/MeshSweeper.h"
 #include "P4.h"
+#include "Scenes.h"
+#include "core/Profiler.h"
 
 MeshMap P4::_defaultMeshes;
 
@@ -55,76 +57,6 @@ makePrimitive(MeshMapIterator mit)
   return new Primitive(mit->second, mit->first);
 }
 
-inline void
-P4::buildScene()
-{
-  //buildScene2();
-  //return;
-  int boxCounter = 0;
-  _current = _scene = new Scene{ "Scene 1" };
-
-  _editor = new SceneEditor{ *_scene };
-  _editor->setDefaultView((float)width() / (float)height());
-
-  auto o = new SceneObject{ "Main Camera", _scene };
-
-  auto camera = new Camera;
-  camera->setViewAngle(60);
-  camera->setClippingPlanes(0.01, 1000);
-  o->setParent(_scene->root());
-  o->setCamera(camera);
-  o->transform()->setLocalPosition(vec3f(0, 4.8, 3.7));
-  o->transform()->rotate(vec3f(-50, 0, 0));
-
-  o->addComponent(camera);
-
-  _objects.push_back(o);
-  _scene->root()->addChild(o);
-  Camera::setCurrent(camera);
-
-  o = new SceneObject{ "box1", _scene };
-
-  auto p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(0.4, 0.3, 0.4));
-  o->transform()->setLocalPosition(vec3f(0, 2.3, 0));
-  _scene->root()->addChild(o);
-
-
-  o = new SceneObject{ "box2", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  _scene->root()->addChild(o);
-
-  auto l = createLight(cg::Light::Type::Spot);
-  o = new SceneObject{ "light0", _scene };
-  l->color = Color::red;
-  l->setGammaL(10);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(1, 10, 0));
-  _scene->root()->addChild(o);
-
-  l = createLight(cg::Light::Type::Spot);
-  o = new SceneObject{ "light1", _scene };
-  l->color = Color::green;
-  l->setGammaL(10);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(-1, 10, 0));
-  _scene->root()->addChild(o);
-
-  l = createLight(cg::Light::Type::Directional);
-  o = new SceneObject{ "light2", _scene };
-  l->color = Color::blue;
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->rotate(vec3f(90, 0, 0));
-  _scene->root()->addChild(o);
-}
-
 inline void
 setObj(Reference<SceneObject> o, vec3f localPos, vec3f localScale, vec3f rotate, Reference<Scene>_scene)
 {
@@ -133,498 +65,64 @@ setObj(Reference<SceneObject> o, vec3f localPos, vec3f localScale, vec3f rotate,
   o->transform()->rotate(rotate);
 }
 
-inline void
-P4::buildScene1()
-{
-  buildScene();
-  _renderer = new GLRenderer{ *_scene };
-  _rayTracer = new RayTracer{ *_scene };
-  _renderer->setProgram(&_programP);
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_POLYGON_OFFSET_FILL);
-  glPolygonOffset(1.0f, 1.0f);
-  glEnable(GL_LINE_SMOOTH);
-  _programG.use();
-}
-
-inline void
-P4::buildScene2()
+TriangleMesh*
+P4::loadMeshAsync(MeshMapIterator mit)
 {
-  _current = _scene = new Scene{ "Scene 2" };
-
-  _renderer = new GLRenderer{ *_scene };
-  _rayTracer = new RayTracer{ *_scene };
-  _renderer->setProgram(&_programP);
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_POLYGON_OFFSET_FILL);
-  glPolygonOffset(1.0f, 1.0f);
-  glEnable(GL_LINE_SMOOTH);
-  _programG.use();
-
-  auto o = new SceneObject{ "Main Camera", _scene };
-
-  auto camera = new Camera;
-  camera->setViewAngle(60);
-  camera->setClippingPlanes(0.01, 1000);
-  o->setParent(_scene->root());
-  o->setCamera(camera);
-  o->transform()->setLocalPosition(vec3f(0, 14, 0));
-  o->transform()->rotate(vec3f(-90, 0, 0));
+  if (mit == Assets::meshes().end() || Assets::hasFailed(mit))
+    return nullptr;
+  if (mit->second != nullptr)
+    return mit->second;
 
-  o->addComponent(camera);
+  // The placeholder stands for the mesh in the scene until it is loaded
+  MeshRef placeholder{Assets::makePlaceholder(mit)};
 
-  _objects.push_back(o);
-  _scene->root()->addChild(o);
-  Camera::setCurrent(camera);
-
-  o = new SceneObject{ "ground", _scene };
-
-  auto p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(7, 0.01, 7));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "base1", _scene };
-  o->setParent(_scene->root());
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(4, 0.25, 4));
-  o->transform()->setLocalPosition(vec3f(0, 0.25, 0));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "base2", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(3.75, 0.5, 3.75));
-  o->transform()->setLocalPosition(vec3f(0, 0.5, 0));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "base3", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(3.5, 0.75, 3.5));
-  o->transform()->setLocalPosition(vec3f(0, 0.75, 0));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "base4", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(3.25, 1, 3.25));
-  o->transform()->setLocalPosition(vec3f(0, 1, 0));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "base5", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(3.0, 1.25, 3.0));
-  o->transform()->setLocalPosition(vec3f(0, 1.25, 0));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "base6", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(2.75, 1.5, 2.75));
-  o->transform()->setLocalPosition(vec3f(0, 1.5, 0));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "base7", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(2.5, 1.75, 2.5));
-  o->transform()->setLocalPosition(vec3f(0, 1.75, 0));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "base8", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(2.0, 2.0, 2.0));
-  o->transform()->setLocalPosition(vec3f(0, 2.0, 0));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "stair1", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(0.1, 1.7, 0.5));
-  o->transform()->setLocalPosition(vec3f(3.4, 1.5, 0));
-  o->transform()->rotate(vec3f(0, 0, 27));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "stair2", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(0.1, 1.7, 0.5));
-  o->transform()->setLocalPosition(vec3f(-3.4, 1.5, 0));
-  o->transform()->rotate(vec3f(0, 0, -27));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "stair3", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(0.5, 1.7, 0.1));
-  o->transform()->setLocalPosition(vec3f(0, 1.5, -3.4));
-  o->transform()->rotate(vec3f(27, 0, 0));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "stair4", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(0.5, 1.7, 0.1));
-  o->transform()->setLocalPosition(vec3f(0, 1.5, 3.4));
-  o->transform()->rotate(vec3f(-27, 0, 0));
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "cupula", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(1.5, 1.5, 1.5));
-  o->transform()->setLocalPosition(vec3f(0, 3.5, 0));
-  _scene->root()->addChild(o);
-
-  //lights  
-  auto l = createLight(cg::Light::Type::Spot);
-  o = new SceneObject{ "light0", _scene };
-  l->color = vec4f(0.4823, 0.4823, 0.4823, 1);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(0, 5.5, 0));
-  _scene->root()->addChild(o);
-
-
-  l = createLight(cg::Light::Type::Spot);
-  o = new SceneObject{ "light1", _scene };
-  l->color = vec4f(1, 0, 0, 1);
-  l->setGammaL(15.f);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(0, 5.9, -0.5));
-  o->transform()->rotate(vec3f(-38, 0, 0));
-  _scene->root()->addChild(o);
-
-  l = createLight(cg::Light::Type::Spot);
-  o = new SceneObject{ "light2", _scene };
-  l->color = vec4f(0, 0, 1, 1);
-  l->setGammaL(15.f);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(0, 5.9, 0.5));
-  o->transform()->rotate(vec3f(38, 0, 0));
-  _scene->root()->addChild(o);
-
-  l = createLight(cg::Light::Type::Spot);
-  o = new SceneObject{ "light3", _scene };
-  l->color = vec4f(0, 1, 0, 1);
-  l->setGammaL(15.f);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(0.5, 5.9, 0));
-  o->transform()->rotate(vec3f(0, 0, -38));
-  _scene->root()->addChild(o);
-
-
-  l = createLight(cg::Light::Type::Directional);
-  o = new SceneObject{ "light4", _scene };
-  l->color = vec4f(1, 0, 0, 1);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->rotate(vec3f(90, 0, 0));
-  _scene->root()->addChild(o);
-
-  l = createLight(cg::Light::Type::Directional);
-  o = new SceneObject{ "light5", _scene };
-  l->color = vec4f(0, 0, 1, 1);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->rotate(vec3f(0, 0, 90));
-  _scene->root()->addChild(o);
-
-  l = createLight(cg::Light::Type::Point);
-  o = new SceneObject{ "light6", _scene };
-  l->color = vec4f(1, 1, 1, 1);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(0, 3.3, 0));
-  _scene->root()->addChild(o);
-
-  camera = new Camera;
-  camera->setViewAngle(60);
-  camera->setClippingPlanes(0.01, 1000);
-
-  o = new SceneObject{ "camera0", _scene };
-  o->setCamera(camera);
-  o->setParent(_scene->root());
-  o->transform()->setLocalPosition(vec3f(-6, 6.8, 6));
-  o->transform()->rotate(vec3f(-37, -45, 0));
-  camera->setProjectionType(Camera::ProjectionType::Parallel);
-
-  o->addComponent(camera);
-
-  _objects.push_back(o);
-  _scene->root()->addChild(o);
-  Camera::setCurrent(camera);
+  bvhMap[placeholder] = new BVH{*placeholder, 16, BVH::SplitMethod::SAH};
+  Assets::loadMeshAsync(mit,
+    [this, placeholder](TriangleMesh* mesh, BVH* bvh)
+    {
+      replaceMesh(placeholder, mesh, bvh);
+    });
+  return placeholder;
 }
 
-inline void
-P4::buildScene3()
+void
+P4::replaceMesh(TriangleMesh* placeholder, TriangleMesh* mesh, BVH* bvh)
 {
-  int boxCounter = 0;
-  _current = _scene = new Scene{ "Scene 3" };
-
-  _editor = new SceneEditor{ *_scene };
-  _editor->setDefaultView((float)width() / (float)height());
-
-  auto o = new SceneObject{ "Main Camera", _scene };
-
-  auto camera = new Camera;
-  camera->setViewAngle(60);
-  camera->setClippingPlanes(0.01, 1000);
-  o->setParent(_scene->root());
-  o->setCamera(camera);
-  o->transform()->setLocalPosition(vec3f(0, 9.8, 0));
-  o->transform()->rotate(vec3f(-20, 135, 0));
-
-  o->addComponent(camera);
-
-  _objects.push_back(o);
-  _scene->root()->addChild(o);
-  Camera::setCurrent(camera);
-
-  o = new SceneObject{ "ground", _scene };
-  auto p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(10, 0.1, 10));
-  o->transform()->setLocalPosition(vec3f(0, -0.2, 0));
-  o->primitive()->material.diffuse = Color::gray;
-  _scene->root()->addChild(o);
-
-
-  o = new SceneObject{ "wall0", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(10, 10, 0.1));
-  o->transform()->setLocalPosition(vec3f(0, 0, -10));
-  o->primitive()->material.diffuse = Color::black;
-  o->primitive()->material.specular = Color::white;
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "wall1", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(10, 10, 0.1));
-  o->transform()->setLocalPosition(vec3f(0, 0, 10));
-  o->primitive()->material.diffuse = Color::black;
-  o->primitive()->material.specular = Color::white;
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "wall2", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(0.1, 10, 10));
-  o->transform()->setLocalPosition(vec3f(-10, 0, 0));
-  o->primitive()->material.diffuse = Color::black;
-  o->primitive()->material.specular = Color::white;
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "wall3", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(0.1, 10, 10));
-  o->transform()->setLocalPosition(vec3f(10, 0, 0));
-  o->primitive()->material.diffuse = Color::black;
-  o->primitive()->material.specular = Color::white;
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "roof", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(10, 0.1, 10));
-  o->transform()->setLocalPosition(vec3f(0, 10, 0));
-  o->primitive()->material.diffuse = Color::cyan;
-  _scene->root()->addChild(o);
-
-
-
-
-
-  o = new SceneObject{ "ball1", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalPosition(vec3f(0, 1, 1));
-  o->primitive()->material.diffuse = Color::blue;
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "ball2", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalPosition(vec3f(5, 1, 2));
-  o->primitive()->material.diffuse = Color::magenta;
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "ball3", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalPosition(vec3f(-5, 1, 3));
-  o->primitive()->material.diffuse = Color::yellow;
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "ball4", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalPosition(vec3f(8, 1, 4));
-  o->primitive()->material.diffuse = Color::green;
-  _scene->root()->addChild(o);
-
-  o = new SceneObject{ "ball5", _scene };
-  p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalPosition(vec3f(-8, 1, 5));
-  o->primitive()->material.diffuse = Color::darkGray;
-  _scene->root()->addChild(o);
-
-
-
-  auto l = createLight(cg::Light::Type::Point);
-  o = new SceneObject{ "light0", _scene };
-  l->color = Color::white;
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(0, 6.3, 0));
-  _scene->root()->addChild(o);
+  // The render job may be traversing the BVH of the placeholder
+  _renderJob = nullptr;
+  if (bvh != nullptr)
+    bvhMap[mesh] = bvh;
+  bvhMap.erase(placeholder);
+
+  // If the mesh could not be loaded, mesh is null and the primitives
+  // are left with no mesh
+  auto it = _scene->getScenePrimitiveIterator();
+  auto end = _scene->getScenePrimitiveEnd();
 
-  _renderer = new GLRenderer{ *_scene };
-  _rayTracer = new RayTracer{ *_scene };
-  _renderer->setProgram(&_programP);
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_POLYGON_OFFSET_FILL);
-  glPolygonOffset(1.0f, 1.0f);
-  glEnable(GL_LINE_SMOOTH);
-  _programG.use();
+  for (; it != end; it++)
+    if (auto p = dynamic_cast<Primitive*>(it->get()))
+      if (p->mesh() == placeholder)
+      {
+        p->setMesh(mesh, p->meshName());
+        p->setbvh(mesh != nullptr ? bvhMap[mesh] : nullptr);
+      }
 }
 
 inline void
-P4::buildScene4()
+P4::buildScene(int n)
 {
-  int boxCounter = 0;
-  _current = _scene = new Scene{ "Scene 4" };
+  // Cancel the current job before the scene is replaced
+  _renderJob = nullptr;
+  _current = _scene = cg::buildScene(n, [this](const std::string& name)
+    {
+      auto mit = _defaultMeshes.find(name);
 
+      if (mit != _defaultMeshes.end())
+        return (TriangleMesh*)mit->second;
+      return loadMeshAsync(Assets::meshes().find(name));
+    });
   _editor = new SceneEditor{ *_scene };
   _editor->setDefaultView((float)width() / (float)height());
-
-  auto o = new SceneObject{ "Main Camera", _scene };
-
-  auto camera = new Camera;
-  camera->setViewAngle(60);
-  camera->setClippingPlanes(0.01, 1000);
-  o->setParent(_scene->root());
-  o->setCamera(camera);
-  o->transform()->setLocalPosition(vec3f(0, 0, 6));
-  o->transform()->rotate(vec3f(0, 0, 0));
-
-  o->addComponent(camera);
-
-  _objects.push_back(o);
-  _scene->root()->addChild(o);
-  Camera::setCurrent(camera);
-
-  o = new SceneObject{ "wall", _scene };
-
-  auto p1 = makePrimitive(_defaultMeshes.find("Box"));
-  o->setParent(_scene->root());
-  o->addComponent(p1);
-  o->transform()->setLocalScale(vec3f(10, 10, 0.1));
-  o->transform()->setLocalPosition(vec3f(0, 0, -9.7));
-  _scene->root()->addChild(o);
-
-
-  o = new SceneObject{ "skull", _scene };
-  o->setParent(_scene->root());
-  o->transform()->setLocalScale(vec3f(0.1, 0.1, 0.1));
-  o->transform()->rotate(vec3f(-90, 0, 0));
-
-
-  auto& meshes = Assets::meshes();
-  for (auto mit = meshes.begin(); mit != meshes.end(); ++mit)
-  {
-    if (std::strcmp(mit->first.c_str(), "skull.obj") == 0)
-    {
-      Assets::loadMesh(mit);
-      auto p = makePrimitive(mit);
-      o->addComponent(p);
-    }
-  }
-  _scene->root()->addChild(o);
-
-  auto l = createLight(cg::Light::Type::Spot);
-  o = new SceneObject{ "light0", _scene };
-  l->color = Color::red;
-  l->setGammaL(28);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(2, -1.7, 4.5));
-  o->transform()->rotate(vec3f(110, 25, 0));
-  _scene->root()->addChild(o);
-
-  l = createLight(cg::Light::Type::Spot);
-  o = new SceneObject{ "light1", _scene };
-  l->color = Color::green;
-  l->setGammaL(28);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(-2, -1.7, 4.5));
-  o->transform()->rotate(vec3f(110, -25, 0));
-  _scene->root()->addChild(o);
-
-  l = createLight(cg::Light::Type::Spot);
-  o = new SceneObject{ "light2", _scene };
-  l->color = Color::green;
-  l->setGammaL(28);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(-1, 10, 0));
-  _scene->root()->addChild(o);
-
-
-  l = createLight(cg::Light::Type::Directional);
-  o = new SceneObject{ "light3", _scene };
-  l->color = Color::darkGray;
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->rotate(vec3f(90, 0, 0));
-  _scene->root()->addChild(o);
-
-  l = createLight(cg::Light::Type::Spot);
-  o = new SceneObject{ "light4", _scene };
-  l->color = Color::blue;
-  l->setGammaL(10);
-  o->setParent(_scene->root());
-  o->addComponent(l);
-  o->transform()->setLocalPosition(vec3f(0, 5.9, 9.1));
-  o->transform()->rotate(vec3f(61, 0, 0));
-  _scene->root()->addChild(o);
-
   _renderer = new GLRenderer{ *_scene };
   _rayTracer = new RayTracer{ *_scene };
   _renderer->setProgram(&_programP);
@@ -640,239 +138,23 @@ P4::buildScene4()
 
 
 
-inline void
-P4::buildScene5()
-{
-	int boxCounter = 0;
-	_current = _scene = new Scene{ "Scene 5" };
-
-	_editor = new SceneEditor{ *_scene };
-	_editor->setDefaultView((float)width() / (float)height());
-
-	auto o = new SceneObject{ "Main Camera", _scene };
-
-	auto camera = new Camera;
-	camera->setViewAngle(60);
-	camera->setClippingPlanes(0.01, 1000);
-	o->setParent(_scene->root());
-	o->setCamera(camera);
-	o->transform()->setLocalPosition(vec3f(0, 0, 6));
-	o->transform()->rotate(vec3f(0, 0, 0));
-
-	o->addComponent(camera);
-
-	_objects.push_back(o);
-	_scene->root()->addChild(o);
-	Camera::setCurrent(camera);
-
-	o = new SceneObject{ "box10", _scene };
-	auto p1 = makePrimitive(_defaultMeshes.find("Box"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalScale(vec3f(5, 5, 0.1));
-	o->transform()->setLocalPosition(vec3f(0, 0, -5));
-	o->primitive()->material.diffuse = Color::red;
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "box11", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Box"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalPosition(vec3f(5, 0, 0));
-	o->transform()->setLocalScale(vec3f(0.1, 5, 5));
-
-	o->primitive()->material.diffuse = Color::green;
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "box12", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Box"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalScale(vec3f(0.1, 5, 5));
-	o->transform()->setLocalPosition(vec3f(-5, 0, 0));
-	o->primitive()->material.diffuse = Color::blue;
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "box18", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Box"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalScale(vec3f(1, 1, 1));
-	o->transform()->setLocalPosition(vec3f(0, 0, -4));
-	o->transform()->rotate(vec3f(45, 45, 45));
-	o->primitive()->material.diffuse.setRGB(255,255,0);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "box19", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Box"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalScale(vec3f(5, 0.1, 5));
-	o->transform()->rotate(vec3f(-45, 0, 0));
-	o->transform()->setLocalPosition(vec3f(0, 2.5, -5));
-	o->primitive()->material.diffuse.setRGB(101,0,179);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "box20", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Box"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalScale(vec3f(5, 0.1, 5));
-	o->transform()->setLocalPosition(vec3f(0, -2.5, -5));
-	o->transform()->rotate(vec3f(45, 0, 0));
-	o->primitive()->material.diffuse.setRGB(255,255,0);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "box23", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Box"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalScale(vec3f(1, 1, 1));
-	o->transform()->rotate(vec3f(0, 5.3, 0));
-	o->transform()->setLocalPosition(vec3f(0, 0, -4));
-	o->primitive()->material.diffuse.setRGB(12,126,232);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	
-
-
-
-
-	o = new SceneObject{ "ball16", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalPosition(vec3f(4, 0, -4));
-	o->primitive()->material.diffuse.setRGB(97, 0, 253);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "ball17", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalPosition(vec3f(-4, 0, -4));
-	o->primitive()->material.diffuse.setRGB(21, 195, 77);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "ball21", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalPosition(vec3f(-4, 0, 0));
-	o->primitive()->material.diffuse.setRGB(255, 255, 0);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "ball22", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalPosition(vec3f(4, 0, 0));
-	o->primitive()->material.diffuse.setRGB(25, 137, 255);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "ball24", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalPosition(vec3f(-5, 3, -4));
-	o->primitive()->material.diffuse.setRGB(232, 106, 2);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "ball25", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalPosition(vec3f(5, 3, -4));
-	o->primitive()->material.diffuse.setRGB(12, 232, 200);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "ball26", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalPosition(vec3f(5, -3, -4));
-	o->primitive()->material.diffuse.setRGB(212, 0, 255);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	o = new SceneObject{ "ball27", _scene };
-	p1 = makePrimitive(_defaultMeshes.find("Sphere"));
-	o->setParent(_scene->root());
-	o->addComponent(p1);
-	o->transform()->setLocalPosition(vec3f(-5, -3, -4));
-	o->primitive()->material.diffuse.setRGB(255, 40, 0);
-	o->primitive()->material.specular = Color::white;
-	_scene->root()->addChild(o);
-
-	
-
-
-
-	auto l = createLight(cg::Light::Type::Point);
-	o = new SceneObject{ "light0", _scene };
-	l->color = Color::white;
-	o->setParent(_scene->root());
-	o->addComponent(l);
-	o->transform()->setLocalPosition(vec3f(0, 0, 0));
-	_scene->root()->addChild(o);
-
-	_renderer = new GLRenderer{ *_scene };
-	_rayTracer = new RayTracer{ *_scene };
-	_renderer->setProgram(&_programP);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_POLYGON_OFFSET_FILL);
-	glPolygonOffset(1.0f, 1.0f);
-	glEnable(GL_LINE_SMOOTH);
-	_programG.use();
-}
-
-
-
-
-
-
 
 
 void
 P4::initialize()
 {
+  Profiler::setThreadName("Main");
   Application::loadShaders(_programG, "shaders/gouraud.vert", "shaders/gouraud.frag");
   Application::loadShaders(_programP, "shaders/phong.vert", "shaders/phong.frag");
   Assets::initialize();
   buildDefaultMeshes();
-  buildScene();
-  _renderer = new GLRenderer{ *_scene };
-  _rayTracer = new RayTracer{ *_scene };
-  _renderer->setProgram(&_programP);
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_POLYGON_OFFSET_FILL);
-  glPolygonOffset(1.0f, 1.0f);
-  glEnable(GL_LINE_SMOOTH);
-  _programG.use();
+  buildScene(1);
 }
 
 Reference<Light>
 P4::createLight(cg::Light::Type type)
 {
-  auto l = new Light();
-  l->setType(type);
-  l->fl(0);
-  l->setGammaL(45);
-  l->decayExponent(0);
-  return l;
+  return cg::createLight(type);
 }
 
 inline void
@@ -1174,7 +456,7 @@ P4::inspectShape(Primitive& primitive)
     if (auto* payload = ImGui::AcceptDragDropPayload("PrimitiveMesh"))
     {
       auto mit = *(MeshMapIterator*)payload->Data;
-      primitive.setMesh(mit->second, mit->first);
+      primitive.setMesh(loadMeshAsync(mit), mit->first);
     }
     ImGui::EndDragDropTarget();
   }
@@ -1189,7 +471,7 @@ P4::inspectShape(Primitive& primitive)
     {
       for (auto mit = meshes.begin(); mit != meshes.end(); ++mit)
         if (ImGui::Selectable(mit->first.c_str()))
-          primitive.setMesh(Assets::loadMesh(mit), mit->first);
+          primitive.setMesh(loadMeshAsync(mit), mit->first);
       ImGui::Separator();
     }
     for (auto mit = _defaultMeshes.begin(); mit != _defaultMeshes.end(); ++mit)
@@ -1574,9 +856,25 @@ P4::assetsWindow()
       auto selected = false;
 
       ImGui::Selectable(meshName, &selected);
+      if (Assets::isLoading(mit))
+      {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(loading)");
+      }
+      else if (Assets::hasFailed(mit))
+      {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(failed)");
+      }
       if (ImGui::BeginDragDropSource())
       {
-        Assets::loadMesh(mit);
+        // Start loading as soon as the mesh is dragged
+        if (mit->second == nullptr && !Assets::isLoading(mit))
+          Assets::loadMeshAsync(mit, [this](TriangleMesh* mesh, BVH* bvh)
+            {
+              if (mesh != nullptr)
+                bvhMap[mesh] = bvh;
+            });
         ImGui::Text(meshName);
         ImGui::SetDragDropPayload("PrimitiveMesh", &mit, sizeof(mit));
         ImGui::EndDragDropSource();
@@ -1601,6 +899,79 @@ P4::editorView()
   ImGui::End();
 }
 
+inline ImU32
+zoneColor(const char* name)
+{
+  // Zones of the same name (i.e., literal) get the same color
+  auto h = uint32_t(uintptr_t(name) * 2654435761u);
+
+  return IM_COL32(96 + (h >> 8 & 127),
+    96 + (h >> 16 & 127),
+    96 + (h >> 24 & 127),
+    255);
+}
+
+inline void
+P4::profilerWindow()
+{
+  if (!_showProfiler)
+    return;
+  ImGui::Begin("Profiler", &_showProfiler);
+
+  auto enabled = Profiler::enabled();
+
+  if (ImGui::Checkbox("Record", &enabled))
+    Profiler::setEnabled(enabled);
+  ImGui::SameLine();
+  if (ImGui::Button("Clear"))
+    Profiler::clear();
+  ImGui::SameLine();
+  if (ImGui::Button("Save Trace"))
+    Profiler::writeTrace("p4-trace.json");
+  ImGui::SliderFloat("Time Span (ms)", &_profilerWindow, 10, 5000, "%.0f");
+
+  // Flame graph of the zones of the last time span, one lane per thread
+  const auto end = Profiler::now();
+  const auto begin = end - int64_t(_profilerWindow * 1e6);
+  auto drawList = ImGui::GetWindowDrawList();
+  auto origin = ImGui::GetCursorScreenPos();
+  auto width = ImGui::GetContentRegionAvail().x;
+  auto rowHeight = ImGui::GetTextLineHeight() + 2;
+  auto scale = width / float(end - begin);
+  auto textColor = ImGui::GetColorU32(ImGuiCol_Text);
+  auto y = origin.y;
+
+  for (const auto& t : Profiler::events(begin))
+  {
+    if (t.events.empty())
+      continue;
+
+    auto depth = 0;
+
+    for (const auto& e : t.events)
+      depth = std::max(depth, e.depth + 1);
+    drawList->AddText({ origin.x, y }, textColor, t.name.c_str());
+    y += rowHeight;
+    for (const auto& e : t.events)
+    {
+      ImVec2 a{ origin.x + std::max(e.begin - begin, int64_t(0)) * scale,
+        y + e.depth * rowHeight };
+      ImVec2 b{ std::max(origin.x + (e.end - begin) * scale, a.x + 1),
+        a.y + rowHeight - 1 };
+
+      drawList->AddRectFilled(a, b, zoneColor(e.name));
+      drawList->PushClipRect(a, b, true);
+      drawList->AddText({ a.x + 2, a.y }, IM_COL32_BLACK, e.name);
+      drawList->PopClipRect();
+      if (ImGui::IsMouseHoveringRect(a, b))
+        ImGui::SetTooltip("%s: %.3f ms", e.name, (e.end - e.begin) * 1e-6);
+    }
+    y += depth * rowHeight + 4;
+  }
+  ImGui::Dummy({ width, y - origin.y });
+  ImGui::End();
+}
+
 inline void
 P4::fileMenu()
 {
@@ -1653,6 +1024,44 @@ P4::showOptions()
   ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.6f);
   showStyleSelector("Color Theme##Selector");
   ImGui::ColorEdit3("Selected Wireframe", _selectedWireframeColor);
+  ImGui::SliderInt("Samples per Pixel", &_maxSamples, 1, 1024);
+  ImGui::SliderFloat("Adaptive Threshold", &_adaptiveThreshold, 0, 0.1f);
+  ImGui::SliderInt("Initial Samples", &_minSamples, 1, 4);
+  ImGui::Checkbox("Wavefront Tracing", &_wavefrontTracing);
+#ifdef RT_STATS
+  ImGui::Checkbox("Cost Heatmap", &_costHeatmap);
+#endif // RT_STATS
+
+  // Tone mapping only converts the rendered radiance again
+  static const char* operators[]{ "Clamp", "Reinhard", "ACES" };
+  auto op = (int)_toneMapping.op;
+  auto changed = ImGui::SliderFloat("Exposure (EV)",
+    &_toneMapping.exposure,
+    -8,
+    8);
+
+  if (ImGui::BeginCombo("Tone Mapping", operators[op]))
+  {
+    for (auto i = 0; i < IM_ARRAYSIZE(operators); ++i)
+    {
+      bool selected = op == i;
+
+      if (ImGui::Selectable(operators[i], selected) && !selected)
+      {
+        _toneMapping.op = (ToneMapping::Operator)i;
+        changed = true;
+      }
+      if (selected)
+        ImGui::SetItemDefaultFocus();
+    }
+    ImGui::EndCombo();
+  }
+  changed |= ImGui::Checkbox("sRGB Output", &_toneMapping.sRGB);
+  if (changed && _renderJob != nullptr)
+    _renderJob->setToneMapping(_toneMapping);
+  if (_rayTracer != nullptr)
+    ImGui::Text("Average samples per pixel: %.2f",
+      _rayTracer->averageSamples());
   ImGui::PopItemWidth();
 }
 
@@ -1684,12 +1093,16 @@ P4::mainMenu()
           ImGui::EndCombo();
           // TODO: change mode only if scene has changed
           if (_viewMode == ViewMode::Editor)
+          {
+            _renderJob = nullptr;
             _image = nullptr;
+          }
         }
       }
       ImGui::Separator();
       ImGui::MenuItem("Assets Window", nullptr, &_showAssets);
       ImGui::MenuItem("Editor View Settings", nullptr, &_showEditorView);
+      ImGui::MenuItem("Profiler", nullptr, &_showProfiler);
       ImGui::EndMenu();
     }
     if (ImGui::BeginMenu("Tools"))
@@ -1705,23 +1118,23 @@ P4::mainMenu()
     {
       if (ImGui::MenuItem("Scene 1"))
       {
-        buildScene1();
+        buildScene(1);
       }
       if (ImGui::MenuItem("Scene 2"))
       {
-        buildScene2();
+        buildScene(2);
       }
 	  if (ImGui::MenuItem("Scene 5"))
 	  {
-		  buildScene5();
+		  buildScene(5);
 	  }
       if (ImGui::MenuItem("Caixa de Espelhos"))
       {
-        buildScene3();
+        buildScene(3);
       }
       if (ImGui::MenuItem("Skull"))
       {
-        buildScene4();
+        buildScene(4);
       }
       ImGui::EndMenu();
     }
@@ -1733,6 +1146,7 @@ void
 P4::gui()
 {
   mainMenu();
+  profilerWindow();
   if (_viewMode == ViewMode::Renderer)
     return;
   hierarchyWindow();
@@ -1781,7 +1195,17 @@ P4::drawPrimitive(Primitive& primitive)
   auto bvh = bvhMap[mesh];
 
   if (bvh == nullptr)
-    bvhMap[mesh] = bvh = new BVH{ *mesh, 16 };
+    bvhMap[mesh] = bvh = cachedBVH(*mesh,
+      Application::assetFilePath("meshes/cache/"));
+  else if (bvh->meshVersion() != mesh->version())
+  {
+    // The render job may be traversing the tree
+    _renderJob = nullptr;
+    // Refitting is much cheaper than rebuilding, unless it degrades
+    // the tree too much
+    if (!bvh->refit())
+      bvhMap[mesh] = bvh = new BVH{ *mesh, 16, BVH::SplitMethod::SAH };
+  }
 
   primitive.setbvh(bvh);
   // **End BVH test
@@ -2020,20 +1444,114 @@ P4::drawCamera(Camera& camera)
 }
 
 
+template <typename T>
+inline void
+hashBytes(uint64_t& h, const T& value)
+{
+  // FNV-1a
+  auto p = (const uint8_t*)&value;
+
+  for (auto e = p + sizeof(T); p != e; ++p)
+    h = (h ^ *p) * 0x100000001b3ull;
+}
+
+uint64_t
+P4::renderSignature(Camera* camera) const
+{
+  // Hash of everything the ray tracer reads from the camera and scene
+  uint64_t h = 0xcbf29ce484222325ull;
+
+  hashBytes(h, camera);
+  hashBytes(h, camera->cameraToWorldMatrix());
+  hashBytes(h, camera->projectionMatrix());
+  hashBytes(h, _scene->backgroundColor);
+  hashBytes(h, _scene->ambientLight);
+  // Adaptive sampling changes which pixels the samples go to
+  hashBytes(h, _adaptiveThreshold);
+  hashBytes(h, _minSamples);
+#ifdef RT_STATS
+  hashBytes(h, _costHeatmap);
+#endif // RT_STATS
+
+  auto it = _scene->getScenePrimitiveIterator();
+  auto end = _scene->getScenePrimitiveEnd();
+
+  for (; it != end; it++)
+  {
+    auto component = it->get();
+    auto object = component->sceneObject();
+
+    hashBytes(h, component);
+    hashBytes(h, object->visible);
+    hashBytes(h, object->transform()->localToWorldMatrix());
+    if (auto p = dynamic_cast<Primitive*>(component))
+    {
+      hashBytes(h, p->mesh());
+      hashBytes(h, p->getbvh());
+      if (auto mesh = p->mesh())
+        hashBytes(h, mesh->version());
+      hashBytes(h, p->material);
+    }
+  }
+
+  auto lit = _scene->getSceneLightsIterator();
+  auto lend = _scene->getSceneLightsEnd();
+
+  for (; lit != lend; lit++)
+  {
+    auto l = lit->get();
+
+    hashBytes(h, l);
+    hashBytes(h, l->sceneObject()->visible);
+    hashBytes(h, l->sceneObject()->transform()->localToWorldMatrix());
+    hashBytes(h, l->type());
+    hashBytes(h, l->color);
+    hashBytes(h, l->fl());
+    hashBytes(h, l->gammaL());
+    hashBytes(h, l->decayExponent());
+  }
+  return h;
+}
+
 inline void
 P4::renderScene()
 {
   if (auto camera = Camera::current())
   {
-    if (_image == nullptr)
-    {
-      const auto w = width(), h = height();
+    // Samples are accumulated by a background job, which starts over
+    // whenever the camera or the scene changes
+    auto signature = renderSignature(camera);
 
-      _image = new GLImage{ w, h };
-      _rayTracer->setImageSize(w, h);
+    if (_image == nullptr || signature != _renderSignature)
+    {
+      // Cancel the current job before touching the ray tracer
+      _renderJob = nullptr;
+      if (_image == nullptr)
+        _image = new GLImage{ width(), height() };
+      _renderSignature = signature;
+      _rayTracer->setImageSize(_image->width(), _image->height());
       _rayTracer->setCamera(camera);
-      _rayTracer->renderImage(*_image);
+      _rayTracer->resetSamples();
+    }
+    // Continue a finished job if the sample limit was raised
+    if (_renderJob == nullptr ||
+      (_renderJob->done() &&
+      _rayTracer->numberOfSamples() < _maxSamples &&
+      !_rayTracer->converged()))
+    {
+      // The job owns the ray tracer until it is done
+      _rayTracer->setWavefrontTracing(_wavefrontTracing);
+#ifdef RT_STATS
+      _rayTracer->setCostHeatmap(_costHeatmap);
+#endif // RT_STATS
+      _rayTracer->setAdaptiveSampling(_adaptiveThreshold, _minSamples);
+      _rayTracer->setToneMapping(_toneMapping);
+      _renderJob = new RenderJob{ *_rayTracer,
+        _image->width(),
+        _image->height(),
+        _maxSamples };
     }
+    _renderJob->update(*_image);
     _image->draw(0, 0);
   }
 }
@@ -2069,6 +1587,8 @@ P4::loadLights()
 void
 P4::render()
 {
+  PROFILE_ZONE("P4::render");
+  Assets::update();
   _programG.use();
   if (_viewMode == ViewMode::Renderer)
   {
@@ -2157,6 +1677,7 @@ P4::windowResizeEvent(int width, int height)
 {
   _editor->camera()->setAspectRatio(float(width) / float(height));
   _viewMode = ViewMode::Editor;
+  _renderJob = nullptr;
   _image = nullptr;
   return true;
 }
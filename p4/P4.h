@@ -8,7 +8,7 @@
 #include "Light.h"
 #include "Primitive.h"
 #include "SceneEditor.h"
-#include "RayTracer.h"
+#include "RenderJob.h"
 #include "core/Flags.h"
 #include "graphics/Application.h"
 #include "graphics/GLImage.h"
@@ -143,21 +143,31 @@ private:
   int _mouseY;
   bool _showAssets{ true };
   bool _showEditorView{ true };
+  bool _showProfiler{};
+  float _profilerWindow{ 100 }; // time span of the flame graph in ms
   ViewMode _viewMode{ ViewMode::Editor };
   Reference<RayTracer> _rayTracer;
   Reference<GLImage> _image;
+  Reference<RenderJob> _renderJob;
+  int _maxSamples{ 256 };
+  bool _wavefrontTracing{};
+#ifdef RT_STATS
+  bool _costHeatmap{};
+#endif // RT_STATS
+  float _adaptiveThreshold{};
+  int _minSamples{ 4 };
+  ToneMapping _toneMapping;
+  uint64_t _renderSignature{};
   BVHMap bvhMap;
 
 
   static MeshMap _defaultMeshes;
 
-  void buildScene();
-  void buildScene1();
-  void buildScene2();
-  void buildScene3();
-  void buildScene4();
-  void buildScene5();
+  void buildScene(int n);
+  TriangleMesh* loadMeshAsync(MeshMapIterator);
+  void replaceMesh(TriangleMesh*, TriangleMesh*, BVH*);
   void renderScene();
+  uint64_t renderSignature(Camera*) const;
 
   void mainMenu();
   void fileMenu();
@@ -167,6 +177,7 @@ private:
   void inspectorWindow();
   void assetsWindow();
   void editorView();
+  void profilerWindow();
   void sceneGui();
   void sceneObjectGui();
   void objectGui();
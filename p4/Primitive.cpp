@@ -30,9 +30,9 @@
 // Author(s): Paulo Pagliosa (and your name)
 // Last revision: 30/10/2018
 
-#include "Primitive.h"
-#include "Transform.h"
+#include "SceneObject.h"
 #include "Intersection.h"
+#include <cmath>
 
 namespace cg
 { // begin namespace cg
@@ -53,6 +53,14 @@ namespace cg
     float tMax;
 
     //localRay.direction *= d; // normaliza raio local
+    if (_bvh != nullptr)
+    {
+      // The BVH tests precomputed SIMD triangle blocks
+      if (!_bvh->intersect(localRay, hit, d))
+        return false;
+      hit.object = this;
+      return true;
+    }
     if (_mesh->bounds().intersect(localRay, tMin, tMax))
     {
       auto triangles = _mesh->data().triangles;
@@ -82,14 +90,14 @@ namespace cg
         vec3f s2 = s.cross(e1);
 
         auto t = s2.dot(e2) * invD;
-        if (!isgreaterequal(t, 0.0f)) continue;
+        if (!std::isgreaterequal(t, 0.0f)) continue;
         if ((distance = t * d) > hit.distance) continue;
 
         auto b1 = s1.dot(s) * invD;
-        if (!isgreaterequal(b1, 0.0f)) continue;
+        if (!std::isgreaterequal(b1, 0.0f)) continue;
 
         auto b2 = s2.dot(localRay.direction) * invD;
-        if (!isgreaterequal(b2, 0.0f)) continue;
+        if (!std::isgreaterequal(b2, 0.0f)) continue;
 
         if (b1 + b2 <= 1.0f)
         {          
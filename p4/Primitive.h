@@ -34,10 +34,11 @@
 #define __Primitive_h
 
 #include "Component.h"
-#include "graphics/GLMesh.h"
+#include "geometry/TriangleMesh.h"
 #include "Material.h"
 #include "Intersection.h"
 #include "BVH.h"
+#include <string>
 
 namespace cg
 { // begin namespace cg
@@ -0,0 +1,204 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: RayPacket.h
+// ========
+// Class definition for packet of coherent rays.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#ifndef __RayPacket_h
+#define __RayPacket_h
+
+#include "BVH.h"
+#ifdef BVH_SIMD
+#include <emmintrin.h>
+#endif // BVH_SIMD
+
+namespace cg
+{ // begin namespace cg
+
+#define PACKET_WIDTH 4
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// RayPacket: packet of PACKET_WIDTH x PACKET_WIDTH rays
+// =========
+// Rays are kept also in SoA form, so that four rays at a time are
+// tested against a box, and as interval bounds of their origins and
+// reciprocal directions, so that boxes missed by the whole packet are
+// culled with a single test. Which rays are alive is given by a mask
+// with one bit per ray.
+struct alignas(16) RayPacket
+{
+  static constexpr int size = PACKET_WIDTH * PACKET_WIDTH;
+
+  Ray rays[size];
+  float d[size]; // factor to convert ray t to hit distance
+  float o[3][size];
+  float invDir[3][size];
+  vec3f oMin, oMax; // bounds of the origins
+  vec3f invMin, invMax; // bounds of the reciprocal directions
+  int dirIsNeg[3];
+  bool coherent; // whether all rays have the same direction signs
+
+  // Computes the SoA data and the bounds of the rays in mask
+  void update(uint32_t mask)
+  {
+    const auto inf = math::Limits<float>::inf();
+    int sign[3]{};
+
+    oMin = invMin = vec3f{ +inf };
+    oMax = invMax = vec3f{ -inf };
+    for (int k = 0; k < size; ++k)
+    {
+      if ((mask & (1u << k)) == 0)
+      {
+        for (int i = 0; i < 3; ++i)
+          o[i][k] = invDir[i][k] = 0;
+        continue;
+      }
+      for (int i = 0; i < 3; ++i)
+      {
+        auto inv = math::inverse(rays[k].direction[i]);
+
+        o[i][k] = rays[k].origin[i];
+        invDir[i][k] = inv;
+        oMin[i] = std::min(oMin[i], o[i][k]);
+        oMax[i] = std::max(oMax[i], o[i][k]);
+        invMin[i] = std::min(invMin[i], inv);
+        invMax[i] = std::max(invMax[i], inv);
+        sign[i] |= inv < 0 ? 2 : 1;
+      }
+    }
+    coherent = sign[0] != 3 && sign[1] != 3 && sign[2] != 3;
+    for (int i = 0; i < 3; ++i)
+      dirIsNeg[i] = sign[i] == 2;
+  }
+
+  // Returns true if no ray of the packet can hit bounds. Only valid
+  // for coherent packets
+  bool misses(const Bounds3f& bounds) const
+  {
+    auto tNear = 0.0f;
+    auto tFar = math::Limits<float>::inf();
+
+    for (int i = 0; i < 3; ++i)
+    {
+      // Rays parallel to a slab could give 0 * inf
+      if (!std::isfinite(invMin[i]) || !std::isfinite(invMax[i]))
+        return false;
+
+      auto p0 = dirIsNeg[i] ? bounds.max()[i] : bounds.min()[i];
+      auto p1 = dirIsNeg[i] ? bounds.min()[i] : bounds.max()[i];
+
+      tNear = std::max(tNear, lower(p0 - oMax[i], p0 - oMin[i], i));
+      tFar = std::min(tFar, upper(p1 - oMax[i], p1 - oMin[i], i));
+    }
+    return tNear > tFar;
+  }
+
+  // Returns the mask of the rays in mask whose t interval overlaps
+  // bounds before the current hit of the ray
+  uint32_t intersect(const Bounds3f& bounds,
+    const Intersection* hit,
+    uint32_t mask) const
+  {
+    uint32_t result = 0;
+
+#ifdef BVH_SIMD
+    const auto& p1 = bounds.min();
+    const auto& p2 = bounds.max();
+
+    for (int k = 0; k < size; k += 4)
+    {
+      auto m = (mask >> k) & 0xf;
+
+      if (m == 0)
+        continue;
+
+      auto tMin = _mm_setzero_ps();
+      auto tMax = _mm_setr_ps(hit[k].distance / d[k],
+        hit[k + 1].distance / d[k + 1],
+        hit[k + 2].distance / d[k + 2],
+        hit[k + 3].distance / d[k + 3]);
+
+      for (int i = 0; i < 3; ++i)
+      {
+        auto o = _mm_load_ps(this->o[i] + k);
+        auto inv = _mm_load_ps(invDir[i] + k);
+        auto t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(p1[i]), o), inv);
+        auto t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(p2[i]), o), inv);
+
+        // Keep the running interval as second operand to drop NaNs
+        tMin = _mm_max_ps(_mm_min_ps(t1, t2), tMin);
+        tMax = _mm_min_ps(_mm_max_ps(t1, t2), tMax);
+      }
+      m &= _mm_movemask_ps(_mm_cmple_ps(tMin, tMax));
+      result |= m << k;
+    }
+#else
+    float tMin, tMax;
+
+    for (int k = 0; k < size; ++k)
+      if ((mask & (1u << k)) != 0 &&
+        bounds.intersect(rays[k], tMin, tMax) &&
+        tMax >= 0 &&
+        tMin * d[k] <= hit[k].distance)
+        result |= 1u << k;
+#endif // BVH_SIMD
+    return result;
+  }
+
+private:
+  // Bounds of [a, b] * [invMin[i], invMax[i]]
+  float lower(float a, float b, int i) const
+  {
+    return std::min(std::min(a * invMin[i], a * invMax[i]),
+      std::min(b * invMin[i], b * invMax[i]));
+  }
+
+  float upper(float a, float b, int i) const
+  {
+    return std::max(std::max(a * invMin[i], a * invMax[i]),
+      std::max(b * invMin[i], b * invMax[i]));
+  }
+
+}; // RayPacket
+
+// Returns the number of rays in mask
+inline int
+bitCount(uint32_t mask)
+{
+  mask = mask - ((mask >> 1) & 0x55555555);
+  mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+  return int(((mask + (mask >> 4)) & 0x0f0f0f0f) * 0x01010101 >> 24);
+}
+
+} // end namespace cg
+
+#endif // __RayPacket_h
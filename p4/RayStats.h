@@ -0,0 +1,98 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: RayStats.h
+// ========
+// Class definition for ray tracing statistics.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#ifndef __RayStats_h
+#define __RayStats_h
+
+#include <cstdint>
+
+// Define RT_STATS (e.g., in the preprocessor definitions of the
+// project) to count the traversal work of the rays. Otherwise, the
+// counters are compiled out and stay zero
+#ifdef RT_STATS
+#define RT_STAT(statement) statement
+#else
+#define RT_STAT(statement)
+#endif // RT_STATS
+
+// Adds n to a counter of the statistics of the current thread, if any
+#define RT_COUNT(counter, n) \
+  RT_STAT(if (auto s_ = cg::RayStats::current) s_->counter += (n))
+
+namespace cg
+{ // begin namespace cg
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// RayStats: ray tracing statistics
+// ========
+// Counters are accumulated by each render thread into the statistics
+// set as its current ones, and then summed up by the ray tracer.
+struct RayStats
+{
+  static constexpr int maxDepth = 21; // MAX_RECURSION_LEVEL + 1
+
+  uint64_t nodesVisited{}; // TLAS and BVH nodes
+  uint64_t boxTests{}; // node children and instance boxes
+  uint64_t triangleTests{}; // SIMD lanes included
+  uint64_t shadowRays{};
+  uint64_t occludedShadowRays{};
+  uint64_t depths[maxDepth]{}; // primary and reflection rays by level
+  double seconds{}; // time spent rendering tiles
+
+  // Statistics the counters of the calling thread go to
+  static inline thread_local RayStats* current;
+
+  // Traversal work, the cost shown by the heatmap
+  uint64_t work() const
+  {
+    return nodesVisited + triangleTests;
+  }
+
+  void add(const RayStats& other)
+  {
+    nodesVisited += other.nodesVisited;
+    boxTests += other.boxTests;
+    triangleTests += other.triangleTests;
+    shadowRays += other.shadowRays;
+    occludedShadowRays += other.occludedShadowRays;
+    for (int i = 0; i < maxDepth; ++i)
+      depths[i] += other.depths[i];
+    seconds += other.seconds;
+  }
+
+}; // RayStats
+
+} // end namespace cg
+
+#endif // __RayStats_h
@@ -33,6 +33,12 @@
 #include "Camera.h"
 #include "RayTracer.h"
 #include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "core/Profiler.h"
+#include "core/ThreadPool.h"
 #include "Primitive.h"
 
 using namespace std;
@@ -46,6 +52,107 @@ namespace cg
     printf("%sElapsed time: %.4f s\n", s, (float)time / CLOCKS_PER_SEC);
   }
 
+#ifdef RT_STATS
+  void
+    printStats(const RayStats& stats, const std::vector<RayStats>& threads)
+  {
+    printf("\nNodes visited: %llu", (unsigned long long)stats.nodesVisited);
+    printf("\nBox tests: %llu", (unsigned long long)stats.boxTests);
+    printf("\nTriangle tests: %llu", (unsigned long long)stats.triangleTests);
+    printf("\nShadow rays: %llu (%llu occluded)",
+      (unsigned long long)stats.shadowRays,
+      (unsigned long long)stats.occludedShadowRays);
+    printf("\nRays by depth:");
+    for (int i = 0; i < RayStats::maxDepth; ++i)
+      if (stats.depths[i] > 0)
+        printf(" %d:%llu", i, (unsigned long long)stats.depths[i]);
+    printf("\nThread times (s):");
+    for (const auto& s : threads)
+      printf(" %.3f", s.seconds);
+  }
+
+  // Blue to cyan, green, yellow and red as t goes from 0 to 1
+  Color
+    heatColor(float t)
+  {
+    static const Color ramp[]{ Color::blue,
+      Color::cyan,
+      Color::green,
+      Color::yellow,
+      Color::red };
+    auto x = std::min(std::max(t, 0.0f), 1.0f) * 4;
+    auto i = std::min(int(x), 3);
+
+    return ramp[i] + (ramp[i + 1] - ramp[i]) * (x - i);
+  }
+#endif // RT_STATS
+
+
+  /////////////////////////////////////////////////////////////////////
+  //
+  // RayTracer::LightList implementation
+  // ====================
+  void
+    RayTracer::LightList::clear()
+  {
+    type.clear();
+    position.clear();
+    direction.clear();
+    color.clear();
+    falloff.clear();
+    cosCutoff.clear();
+    decayExponent.clear();
+  }
+
+  void
+    RayTracer::LightList::add(Light& light)
+  {
+    auto t = light.sceneObject()->transform();
+
+    type.push_back(light.type());
+    position.push_back(t->position());
+    direction.push_back(t->rotation() * vec3f(0, -1, 0));
+    color.push_back(light.color);
+    falloff.push_back(light.fl());
+    cosCutoff.push_back(cos(math::toRadians(std::min(light.gammaL(), 180.f))));
+    decayExponent.push_back(light.decayExponent());
+  }
+
+  bool
+    RayTracer::LightList::reaches(int k, const vec3f& p) const
+  {
+    // same test as RayTracer::illuminate()
+    return type[k] != Light::Type::Spot ||
+      direction[k].dot(-(position[k] - p).versor()) >= cosCutoff[k];
+  }
+
+  bool
+    RayTracer::LightList::mayReach(int k, const Bounds3f& bounds) const
+    //[]---------------------------------------------------[]
+    //|  May reach                                          |
+    //|  A spot reaches the bounding sphere of the bounds   |
+    //|  if the angle between the spot axis and the sphere  |
+    //|  center, less the angle the sphere subtends, is     |
+    //|  within the cone                                    |
+    //[]---------------------------------------------------[]
+  {
+    if (type[k] != Light::Type::Spot)
+      return true;
+
+    auto V = bounds.center() - position[k];
+    auto d = V.length();
+    auto r = 0.5f * bounds.diagonalLength();
+
+    if (d <= r)
+      return true;
+
+    auto cosV = std::clamp(direction[k].dot(V) / d, -1.0f, 1.0f);
+    // a small slack keeps the test conservative against rounding
+    const auto slack = 1e-3f;
+
+    return acos(cosV) - asin(r / d) <= acos(cosCutoff[k]) + slack;
+  }
+
 
   /////////////////////////////////////////////////////////////////////
   //
@@ -56,7 +163,7 @@ namespace cg
     _maxRecursionLevel{ 10 },
     _minWeight{ MIN_WEIGHT }
   {
-    // TODO: BVH
+    // do nothing
   }
 
   void
@@ -76,7 +183,159 @@ namespace cg
   void
     RayTracer::renderImage(Image& image)
   {
+    PROFILE_ZONE("RayTracer::renderImage");
+
     auto t = clock();
+    ImageBuffer frame{ image.width(), image.height() };
+
+    _numberOfSamples = 0;
+    if (_adaptiveThreshold > 0)
+      do
+        renderSample(frame);
+      while (!converged() && _numberOfSamples < _maxSamples);
+    else
+    {
+      begin(image.width(), image.height());
+      _samples.clear();
+      _totalSamples = uint64_t(_W) * _H;
+      resetRayCounts();
+      scan(frame);
+    }
+    image.setData(frame);
+    printf("\nNumber of rays: %llu", (unsigned long long)_numberOfRays);
+    printf("\nNumber of hits: %llu", (unsigned long long)_numberOfHits);
+    printf("\nSamples per pixel: %.2f", averageSamples());
+    RT_STAT(printStats(stats(), _threadStats));
+    printElapsedTime("\nDONE! ", clock() - t);
+  }
+
+  void
+    RayTracer::renderSample(Image& image)
+  {
+    ImageBuffer frame{ image.width(), image.height() };
+
+    renderSample(frame);
+    image.setData(frame);
+  }
+
+  void
+    RayTracer::renderSample(ImageBuffer& frame,
+      const TileFunction& tileDone,
+      const std::atomic<bool>* cancel)
+  {
+    PROFILE_ZONE("RayTracer::renderSample");
+
+    if (_numberOfSamples == 0)
+    {
+      auto n = size_t(frame.width()) * frame.height();
+
+      begin(frame.width(), frame.height());
+      _samples.assign(n, Color::black);
+      _sampleCounts.assign(n, 0);
+      if (_adaptiveThreshold > 0)
+      {
+        _luminances.assign(n, 0);
+        _squares.assign(n, 0);
+      }
+      else
+      {
+        _luminances.clear();
+        _squares.clear();
+      }
+      _active.clear();
+      _activePixels = int(n);
+      _totalSamples = 0;
+      resetRayCounts();
+    }
+    ++_numberOfSamples;
+    scan(frame, tileDone, cancel);
+    if (cancel != nullptr && *cancel)
+    {
+      _numberOfSamples = 0;
+      return;
+    }
+    _totalSamples += _activePixels;
+    if (!_squares.empty() && _numberOfSamples >= _minSamples)
+      updateActivePixels();
+  }
+
+  inline float
+    luminance(const Color& c)
+  {
+    return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+  }
+
+  inline Color
+    clamp(const Color& c)
+  {
+    return Color{ std::min(c.r, 1.0f),
+      std::min(c.g, 1.0f),
+      std::min(c.b, 1.0f) };
+  }
+
+  void
+    RayTracer::updateActivePixels()
+    //[]---------------------------------------------------[]
+    //|  Update active pixels                               |
+    //|  A pixel is sampled again if the standard error of  |
+    //|  its mean luminance exceeds the threshold (with a   |
+    //|  single sample, if it differs by more than that     |
+    //|  from a 4-neighbor). Up to twice the initial        |
+    //|  samples, so is a pixel whose mean differs by more  |
+    //|  than the threshold from an active 4-neighbor,      |
+    //|  which catches edges missed by all its samples      |
+    //[]---------------------------------------------------[]
+  {
+    const auto t = _adaptiveThreshold;
+    const auto n = _samples.size();
+    std::vector<float> means(n);
+    std::vector<uint8_t> noisy(n);
+
+    for (size_t k = 0; k < n; ++k)
+      means[k] = _luminances[k] * math::inverse(float(_sampleCounts[k]));
+    ThreadPool::global().parallelFor(_H, [&](int j, int)
+      {
+        for (int i = 0; i < _W; ++i)
+        {
+          auto k = size_t(j) * _W + i;
+          auto c = float(_sampleCounts[k]);
+          auto m = means[k];
+
+          if (c > 1)
+            noisy[k] = std::max(_squares[k] / c - m * m, 0.0f) > t * t * c;
+          else
+            noisy[k] = (i > 0 && abs(m - means[k - 1]) > t) ||
+              (i + 1 < _W && abs(m - means[k + 1]) > t) ||
+              (j > 0 && abs(m - means[k - _W]) > t) ||
+              (j + 1 < _H && abs(m - means[k + _W]) > t);
+        }
+      }, _numberOfThreads);
+    _active.resize(n);
+    ThreadPool::global().parallelFor(_H, [&](int j, int)
+      {
+        for (int i = 0; i < _W; ++i)
+        {
+          auto k = size_t(j) * _W + i;
+          auto m = means[k];
+          auto edge = [&](size_t q)
+          {
+            return noisy[q] && abs(m - means[q]) > t;
+          };
+
+          _active[k] = noisy[k] ||
+            (_sampleCounts[k] < 2 * _minSamples &&
+            ((i > 0 && edge(k - 1)) ||
+            (i + 1 < _W && edge(k + 1)) ||
+            (j > 0 && edge(k - _W)) ||
+            (j + 1 < _H && edge(k + _W))));
+        }
+      }, _numberOfThreads);
+    _activePixels = int(std::count(_active.begin(), _active.end(), 1));
+  }
+
+  void
+    RayTracer::begin(int w, int h)
+  {
     const auto& m = _camera->cameraToWorldMatrix();
 
     // VRC axes
@@ -84,29 +343,103 @@ namespace cg
     _vrc.v = m[1];
     _vrc.n = m[2];
     // init auxiliary mapping variables
-    _W = image.width();
-    _H = image.height();
+    _W = w;
+    _H = h;
     _Iw = math::inverse(float(_W));
     _Ih = math::inverse(float(_H));
+    if (_radiance.width() != _W || _radiance.height() != _H)
+      _radiance = HDRBuffer{ _W, _H };
 
     auto height = windowHeight(_camera);
 
     _W >= _H ? _Vw = (_Vh = height) * _W * _Ih : _Vh = (_Vw = height) * _H * _Iw;
-    // init pixel ray
-    _pixelRay.origin = _camera->transform()->position();
-    _pixelRay.direction = -_vrc.n;
-    _camera->clippingPlanes(_pixelRay.tMin, _pixelRay.tMax);
-    _numberOfRays = _numberOfHits = 0;
-    scan(image);
-    printf("\nNumber of rays: %llu", _numberOfRays);
-    printf("\nNumber of hits: %llu", _numberOfHits);
-    printElapsedTime("\nDONE! ", clock() - t);
+    // build the top-level BVH over the scene primitives, or refit the
+    // one of the previous frame if only transforms and vertices changed
+    if (_tlas == nullptr || !_tlas->refit(*_scene))
+      _tlas = new TLAS{ *_scene };
+    // flatten the scene lights
+    _lights.clear();
+    for (auto it = _scene->getSceneLightsIterator();
+      it != _scene->getSceneLightsEnd();
+      it++)
+      _lights.add(**it);
+
+    auto camera = Camera::current();
+
+    if (camera == nullptr)
+      camera = _camera;
+    _eye = camera->transform()->position();
+    // lights only add ambient light to the points they illuminate, so
+    // unreached points can be skipped only if there is none
+    _cullLights = _scene->ambientLight == Color::black;
+  }
+
+  inline uint32_t
+    hash(uint32_t x)
+  {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+  }
+
+  vec2f
+    RayTracer::sampleOffset(int i, int j) const
+    //[]---------------------------------------------------[]
+    //|  Sample offset                                      |
+    //|  The offset of the current sample in pixel (i,j)    |
+    //|  depends only on the pixel and on the sample        |
+    //|  number, so passes are the same for any number of   |
+    //|  threads and any tile order                         |
+    //[]---------------------------------------------------[]
+  {
+    if (_numberOfSamples <= 1)
+      return { 0.5f, 0.5f };
+
+    auto h = hash(uint32_t(j * _W + i) ^ hash(uint32_t(_numberOfSamples)));
+    const auto s = 1.0f / 65536;
+
+    return { (h & 0xffff) * s, (h >> 16) * s };
+  }
+
+  inline void
+    RayTracer::writePixel(int i, int j, const Color& c)
+  {
+    if (_samples.empty())
+      _radiance(i, j) = c;
+    else
+    {
+      auto k = size_t(j) * _W + i;
+      auto& sum = _samples[k];
+
+      sum += c;
+      if (!_squares.empty())
+      {
+        // The error is measured on displayable (clamped) luminances
+        auto y = luminance(clamp(c));
+
+        _luminances[k] += y;
+        _squares[k] += y * y;
+      }
+      _radiance(i, j) = sum * math::inverse(float(++_sampleCounts[k]));
+    }
+  }
+
+  inline void
+    RayTracer::writeAccumulated(int i, int j)
+  {
+    auto k = size_t(j) * _W + i;
+
+    _radiance(i, j) = _samples[k] * math::inverse(float(_sampleCounts[k]));
   }
 
   void
-    RayTracer::setPixelRay(float x, float y)
+    RayTracer::setPixelRay(Context& context, float x, float y)
     //[]---------------------------------------------------[]
     //|  Set pixel ray                                      |
+    //|  @param per-thread ray state                        |
     //|  @param x coordinate of the pixel                   |
     //|  @param y cordinates of the pixel                   |
     //[]---------------------------------------------------[]
@@ -116,61 +449,518 @@ namespace cg
     switch (_camera->projectionType())
     {
     case Camera::Perspective:
-      _pixelRay.direction = (p - _camera->nearPlane() * _vrc.n).versor();
+      context.pixelRay.direction = (p - _camera->nearPlane() * _vrc.n).versor();
       break;
 
     case Camera::Parallel:
-      _pixelRay.origin = _camera->transform()->position() + p;
+      context.pixelRay.origin = _camera->transform()->position() + p;
       break;
     }
   }
 
   void
-    RayTracer::scan(Image& image)
+    RayTracer::scan(ImageBuffer& frame,
+      const TileFunction& tileDone,
+      const std::atomic<bool>* cancel)
+    //[]---------------------------------------------------[]
+    //|  Scan the image by tiles                            |
+    //|  Tiles are taken from a shared counter by the       |
+    //|  render threads, each one with its own ray state.   |
+    //|  Pixels do not depend on the order they are shot,   |
+    //|  so the image is the same for any thread count      |
+    //|  @param frame buffer (output, tone-mapped from      |
+    //|  the radiance of each tile when it is done)         |
+    //|  @param function called when a tile is done         |
+    //|  @param cancel flag (tiles are skipped when set)    |
+    //[]---------------------------------------------------[]
   {
-    ImageBuffer scanLine{ _W, 1 };
+    auto nx = (_W + TILE_SIZE - 1) / TILE_SIZE;
+    auto ny = (_H + TILE_SIZE - 1) / TILE_SIZE;
+    auto& pool = ThreadPool::global();
+    std::vector<Context> contexts(pool.concurrency(_numberOfThreads));
+    std::atomic<int> tileCount{};
 
-    for (int j = 0; j < _H; j++)
+    // init the pixel ray of each thread; setPixelRay() only changes
+    // its direction (perspective) or origin (parallel)
+    for (auto& context : contexts)
     {
-      auto y = (float)j + 0.5f;
+      auto& ray = context.pixelRay;
+
+      ray.origin = _camera->transform()->position();
+      ray.direction = -_vrc.n;
+      _camera->clippingPlanes(ray.tMin, ray.tMax);
+    }
+    pool.parallelFor(nx * ny, [&](int tile, int slot)
+      {
+        if (cancel != nullptr && *cancel)
+          return;
+
+        PROFILE_ZONE("RayTracer::tile");
+        auto& context = contexts[slot];
+        RT_STAT(auto start = std::chrono::steady_clock::now());
+        RT_STAT(RayStats::current = &context.stats);
+        auto x0 = tile % nx * TILE_SIZE;
+        auto y0 = tile / nx * TILE_SIZE;
+        auto x1 = std::min(x0 + TILE_SIZE, _W);
+        auto y1 = std::min(y0 + TILE_SIZE, _H);
+        auto active = _active.empty();
 
-      printf("Scanning line %d of %d\r", j + 1, _H);
-      for (int i = 0; i < _W; i++)
-        scanLine[i] = shoot((float)i + 0.5f, y);
-      image.setData(0, j, scanLine);
+        // Pixels that need no more samples keep their accumulated color
+        if (!active)
+          for (int j = y0; j < y1; j++)
+            for (int i = x0; i < x1; i++)
+            {
+              if (isActive(i, j))
+                active = true;
+              else
+                writeAccumulated(i, j);
+            }
+        if (active)
+        {
+#ifdef RT_STATS
+          if (_costHeatmap)
+          {
+            for (int j = y0; j < y1; j++)
+              for (int i = x0; i < x1; i++)
+                if (isActive(i, j))
+                {
+                  auto s = sampleOffset(i, j);
+                  auto work = context.stats.work();
+
+                  shoot(context, i + s.x, j + s.y);
+                  work = context.stats.work() - work;
+                  writePixel(i, j, heatColor(log2f(1.0f + work) /
+                    log2f(1.0f + _maxCost)));
+                }
+          }
+          else
+#endif // RT_STATS
+          if (_wavefrontTracing)
+            shootWavefront(context, x0, y0, x1, y1);
+          else if (_packetTracing)
+            for (int j = y0; j < y1; j += PACKET_WIDTH)
+              for (int i = x0; i < x1; i += PACKET_WIDTH)
+                shootPacket(context,
+                  i,
+                  j,
+                  std::min(i + PACKET_WIDTH, x1),
+                  std::min(j + PACKET_WIDTH, y1));
+          else
+            for (int j = y0; j < y1; j++)
+              for (int i = x0; i < x1; i++)
+                if (isActive(i, j))
+                {
+                  auto s = sampleOffset(i, j);
+
+                  writePixel(i, j, shoot(context, i + s.x, j + s.y));
+                }
+        }
+        RT_STAT(RayStats::current = nullptr);
+        RT_STAT(context.stats.seconds += std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count());
+        _radiance.toneMap(frame, _toneMapping, x0, y0, x1 - x0, y1 - y0);
+        if (tileDone && active)
+          tileDone(x0, y0, x1 - x0, y1 - y0);
+        tileCount++;
+        if (slot == 0 && _samples.empty())
+          printf("Scanning tile %d of %d\r", tileCount.load(), nx * ny);
+      }, _numberOfThreads);
+    for (const auto& context : contexts)
+    {
+      _numberOfRays += context.numberOfRays;
+      _numberOfPrimaryRays += context.numberOfPrimaryRays;
+      _numberOfShadowRays += context.numberOfShadowRays;
+      _numberOfHits += context.numberOfHits;
     }
+    if (_threadStats.size() < contexts.size())
+      _threadStats.resize(contexts.size());
+    for (size_t i = 0; i < contexts.size(); ++i)
+      _threadStats[i].add(contexts[i].stats);
   }
 
   Color
-    RayTracer::shoot(float x, float y)
+    RayTracer::shoot(Context& context, float x, float y)
     //[]---------------------------------------------------[]
     //|  Shoot a pixel ray                                  |
+    //|  @param per-thread ray state                        |
     //|  @param x coordinate of the pixel                   |
     //|  @param y cordinates of the pixel                   |
-    //|  @return RGB color of the pixel                     |
+    //|  @return RGB radiance of the pixel                  |
     //[]---------------------------------------------------[]
   {
     // set pixel ray
-    setPixelRay(x, y);
+    setPixelRay(context, x, y);
+
+    // trace pixel ray (the radiance is tone-mapped per tile)
+    return trace(context, context.pixelRay, 0, 1.0f);
+  }
 
-    // trace pixel ray
-    Color color = trace(_pixelRay, 0, 1.0f);
+  void
+    RayTracer::shootPacket(Context& context,
+      int x0,
+      int y0,
+      int x1,
+      int y1)
+    //[]---------------------------------------------------[]
+    //|  Shoot a packet of pixel rays                       |
+    //|  The rays of the pixels in [x0,x1)x[y0,y1) are      |
+    //|  traced together and shaded one by one. Packets     |
+    //|  whose direction signs differ are shot ray by ray   |
+    //|  @param per-thread ray state                        |
+    //|  @param bounds of the pixel block                   |
+    //[]---------------------------------------------------[]
+  {
+    RayPacket packet;
+    Intersection hit[RayPacket::size];
+    uint32_t mask = 0;
+
+    for (int j = y0; j < y1; j++)
+      for (int i = x0; i < x1; i++)
+      {
+        if (!isActive(i, j))
+          continue;
+
+        auto k = (j - y0) * PACKET_WIDTH + i - x0;
+
+        auto s = sampleOffset(i, j);
+
+        setPixelRay(context, i + s.x, j + s.y);
+        packet.rays[k] = context.pixelRay;
+        packet.d[k] = 1;
+        hit[k].object = nullptr;
+        hit[k].distance = context.pixelRay.tMax;
+        mask |= 1u << k;
+      }
+    if (mask == 0)
+      return;
+    packet.update(mask);
+    if (!packet.coherent)
+    {
+      for (int j = y0; j < y1; j++)
+        for (int i = x0; i < x1; i++)
+          if (isActive(i, j))
+          {
+            auto s = sampleOffset(i, j);
+
+            writePixel(i, j, shoot(context, i + s.x, j + s.y));
+          }
+      return;
+    }
+
+    auto hits = _tlas->intersect(packet, hit, mask);
+
+    for (int j = y0; j < y1; j++)
+      for (int i = x0; i < x1; i++)
+      {
+        auto k = (j - y0) * PACKET_WIDTH + i - x0;
+        Color color;
 
-    // adjust RGB color
-    if (color.r > 1.0f)
-      color.r = 1.0f;
-    if (color.g > 1.0f)
-      color.g = 1.0f;
-    if (color.b > 1.0f)
-      color.b = 1.0f;
-    // return pixel color
-    return color;
+        if ((mask & (1u << k)) == 0)
+          continue;
+
+        // same as trace() at level 0
+        context.numberOfRays++;
+        context.numberOfPrimaryRays++;
+        RT_COUNT(depths[0], 1);
+        if ((hits & (1u << k)) == 0)
+          color = background();
+        else
+        {
+          context.numberOfHits++;
+          color = shade(context, packet.rays[k], hit[k], 0, 1.0f);
+        }
+        writePixel(i, j, color);
+      }
+  }
+
+  void
+    RayTracer::shootWavefront(Context& context,
+      int x0,
+      int y0,
+      int x1,
+      int y1)
+    //[]---------------------------------------------------[]
+    //|  Shoot the pixel rays of a tile bounce by bounce    |
+    //|  Each bounce intersects the rays of its queue,      |
+    //|  traces the shadow rays of all the hits light by    |
+    //|  light, and shades the hits, queueing the sorted    |
+    //|  reflection rays for the next bounce. The colors    |
+    //|  are then resolved backwards as trace() returns     |
+    //|  them, so the image is the same as shoot()'s        |
+    //|  @param per-thread ray state                        |
+    //|  @param bounds of the tile                          |
+    //[]---------------------------------------------------[]
+  {
+    auto w = x1 - x0;
+    auto& rays = context.rays;
+    const auto& lights = context.lights;
+
+    // Pixel rays are queued by packet, so that the rays of a packet of
+    // active pixels are consecutive
+    rays.clear();
+    for (int y = y0; y < y1; y += PACKET_WIDTH)
+      for (int x = x0; x < x1; x += PACKET_WIDTH)
+        for (int j = y, ye = std::min(y + PACKET_WIDTH, y1); j < ye; j++)
+          for (int i = x, xe = std::min(x + PACKET_WIDTH, x1); i < xe; i++)
+            if (isActive(i, j))
+            {
+              auto s = sampleOffset(i, j);
+
+              setPixelRay(context, i + s.x, j + s.y);
+              rays.push_back({ context.pixelRay, (j - y0) * w + i - x0, 1.0f });
+            }
+    uint32_t level = 0;
+
+    for (; !rays.empty(); ++level)
+    {
+      auto n = (int)rays.size();
+      auto& hits = context.hits;
+      auto& segments = context.segments[level];
+
+      hits.resize(n);
+      if (level == 0)
+        context.numberOfPrimaryRays += n;
+      RT_COUNT(depths[level], n);
+      if (level == 0 && _packetTracing)
+        tracePrimary(context, w);
+      else
+        for (int r = 0; r < n; ++r)
+        {
+          context.numberOfRays++;
+          intersect(context, rays[r].ray, hits[r]);
+        }
+      traceShadows(context);
+      segments.resize(n);
+      context.nextRays.clear();
+      for (int r = 0; r < n; ++r)
+      {
+        const auto& ray = rays[r];
+        auto& segment = segments[r];
+
+        segment.parent = ray.parent;
+        segment.Or = Color::black;
+        if (hits[r].object == nullptr)
+        {
+          segment.color = background();
+          continue;
+        }
+
+        const auto& material = hits[r].object->material;
+        const auto& s = context.points[r];
+        const auto nl = (int)lights.size();
+        auto visible = &context.visible[size_t(r) * nl];
+        auto Or = material.specular;
+        auto weight = ray.weight * std::max({ Or.r, Or.g, Or.b });
+        Color I = Color::black;
+
+        for (int k = 0; k < nl; ++k)
+          if (visible[k])
+            illuminate(I, material, lights[k], s);
+        segment.color = I;
+        segment.Or = Or;
+        // trace() returns black beyond the maximum level, which adds
+        // nothing to the color
+        if (Or != Color::black &&
+          weight > _minWeight &&
+          level < _maxRecursionLevel)
+        {
+          auto Rf = ray.ray.direction - 2 * s.N.dot(ray.ray.direction) * s.N;
+
+          context.nextRays.push_back({ { s.p,Rf }, r, weight });
+        }
+      }
+      sortRays(context);
+    }
+
+    const auto bg = background();
+
+    // Add the reflected colors, deepest bounce first
+    while (--level > 0)
+      for (const auto& segment : context.segments[level])
+        if (segment.color != bg)
+        {
+          auto& parent = context.segments[level - 1][segment.parent];
+
+          parent.color += parent.Or * segment.color;
+        }
+
+    for (const auto& segment : context.segments[0])
+      writePixel(x0 + segment.parent % w,
+        y0 + segment.parent / w,
+        segment.color);
+  }
+
+  void
+    RayTracer::tracePrimary(Context& context, int w)
+    //[]---------------------------------------------------[]
+    //|  Trace primary rays                                 |
+    //|  The queued pixel rays of each packet of a tile of  |
+    //|  width w are intersected together, as in            |
+    //|  shootPacket()                                      |
+    //|  @param per-thread ray state                        |
+    //|  @param width of the tile                           |
+    //[]---------------------------------------------------[]
+  {
+    RayPacket packet;
+    Intersection hit[RayPacket::size];
+    const auto& rays = context.rays;
+    const auto n = (int)rays.size();
+    auto packetOf = [w](int pixel)
+    {
+      return pixel / w / PACKET_WIDTH * w + pixel % w / PACKET_WIDTH;
+    };
+
+    for (int first = 0, last; first < n; first = last)
+    {
+      auto id = packetOf(rays[first].parent);
+      uint32_t mask = 0;
+
+      for (last = first; last < n && packetOf(rays[last].parent) == id; ++last)
+      {
+        auto k = last - first;
+
+        packet.rays[k] = rays[last].ray;
+        packet.d[k] = 1;
+        hit[k].object = nullptr;
+        hit[k].distance = packet.rays[k].tMax;
+        mask |= 1u << k;
+      }
+      packet.update(mask);
+
+      auto hits = packet.coherent ? _tlas->intersect(packet, hit, mask) : 0;
+
+      for (int r = first; r < last; ++r)
+      {
+        auto k = r - first;
+        auto& h = context.hits[r];
+
+        context.numberOfRays++;
+        if (!packet.coherent)
+          intersect(context, packet.rays[k], h);
+        else
+        {
+          h = hit[k];
+          if ((hits & (1u << k)) != 0)
+            context.numberOfHits++;
+        }
+      }
+    }
+  }
+
+  void
+    RayTracer::traceShadows(Context& context)
+    //[]---------------------------------------------------[]
+    //|  Trace shadow rays                                  |
+    //|  Computes the surface points of the hits of the     |
+    //|  current bounce and traces their shadow rays, all   |
+    //|  the rays towards a light in a row. Lights that     |
+    //|  cannot reach the bounds of the points are culled,  |
+    //|  and so are the rays towards points out of a spot   |
+    //|  @param per-thread ray state                        |
+    //[]---------------------------------------------------[]
+  {
+    const auto n = (int)context.rays.size();
+    auto& lights = context.lights;
+    Bounds3f bounds;
+    auto count = 0;
+
+    context.points.resize(n);
+    for (int r = 0; r < n; ++r)
+      if (context.hits[r].object != nullptr)
+      {
+        context.points[r] = surfacePoint(context.rays[r].ray, context.hits[r]);
+        bounds.inflate(context.points[r].p);
+        count++;
+      }
+    lights.clear();
+    if (count == 0)
+      return;
+    for (int k = 0; k < _lights.size(); ++k)
+      if (!_cullLights || _lights.mayReach(k, bounds))
+        lights.push_back(k);
+
+    const auto nl = (int)lights.size();
+
+    context.visible.assign(size_t(n) * nl, 0);
+    for (int k = 0; k < nl; ++k)
+    {
+      auto l = lights[k];
+
+      for (int r = 0; r < n; ++r)
+      {
+        const auto& p = context.points[r].p;
+
+        if (context.hits[r].object != nullptr &&
+          (!_cullLights || _lights.reaches(l, p)))
+          context.visible[size_t(r) * nl + k] =
+            !shadow(context, lightRay(l, p));
+      }
+    }
+  }
+
+  // Spreads the 10 lowest bits of x to every third bit
+  inline uint32_t
+    spreadBits(uint32_t x)
+  {
+    x &= 0x3ff;
+    x = (x | x << 16) & 0x30000ff;
+    x = (x | x << 8) & 0x300f00f;
+    x = (x | x << 4) & 0x30c30c3;
+    x = (x | x << 2) & 0x9249249;
+    return x;
+  }
+
+  void
+    RayTracer::sortRays(Context& context)
+    //[]---------------------------------------------------[]
+    //|  Sort rays                                          |
+    //|  Moves the queued reflection rays to the ray queue  |
+    //|  of the next bounce, sorted by direction octant     |
+    //|  and then by the Morton code of their origins, so   |
+    //|  that rays traced in a row visit the same nodes     |
+    //|  @param per-thread ray state                        |
+    //[]---------------------------------------------------[]
+  {
+    const auto& next = context.nextRays;
+    auto n = (int)next.size();
+    auto& keys = context.keys;
+    Bounds3f bounds;
+
+    for (const auto& r : next)
+      bounds.inflate(r.ray.origin);
+
+    auto size = bounds.size();
+
+    for (int i = 0; i < 3; ++i)
+      size[i] = size[i] > 0 ? 1023 * math::inverse(size[i]) : 0;
+    keys.resize(n);
+    for (int i = 0; i < n; ++i)
+    {
+      const auto& ray = next[i].ray;
+      auto p = (ray.origin - bounds.min()) * size;
+      auto octant = (ray.direction.x < 0) << 2 |
+        (ray.direction.y < 0) << 1 |
+        (ray.direction.z < 0);
+      auto code = spreadBits(uint32_t(p.x)) << 2 |
+        spreadBits(uint32_t(p.y)) << 1 |
+        spreadBits(uint32_t(p.z));
+
+      keys[i] = { uint64_t(octant) << 32 | code, i };
+    }
+    std::sort(keys.begin(), keys.end());
+    context.rays.resize(n);
+    for (int i = 0; i < n; ++i)
+      context.rays[i] = next[keys[i].second];
   }
 
   Color
-    RayTracer::trace(const Ray& ray, uint32_t level, float weight)
+    RayTracer::trace(Context& context,
+      const Ray& ray,
+      uint32_t level,
+      float weight)
     //[]---------------------------------------------------[]
     //|  Trace a ray                                        |
+    //|  @param per-thread ray state                        |
     //|  @param the ray                                     |
     //|  @param recursion level                             |
     //|  @param ray weight                                  |
@@ -179,11 +969,16 @@ namespace cg
   {
     if (level > _maxRecursionLevel)
       return Color::black;
-    _numberOfRays++;
+    context.numberOfRays++;
+    if (level == 0)
+      context.numberOfPrimaryRays++;
+    RT_COUNT(depths[level], 1);
 
     Intersection hit;
 
-    return intersect(ray, hit) ? shade(ray, hit, level, weight) : background();
+    return intersect(context, ray, hit) ?
+      shade(context, ray, hit, level, weight) :
+      background();
   }
 
   inline constexpr auto
@@ -239,9 +1034,10 @@ namespace cg
   //}
 
   bool
-    RayTracer::intersect(const Ray& ray, Intersection& hit)
+    RayTracer::intersect(Context& context, const Ray& ray, Intersection& hit)
     //[]---------------------------------------------------[]
     //|  Ray/object intersection                            |
+    //|  @param per-thread ray state                        |
     //|  @param the ray (input)                             |
     //|  @param information on intersection (output)        |
     //|  @return true if the ray intersects an object       |
@@ -249,49 +1045,22 @@ namespace cg
   {
     hit.object = nullptr;
     hit.distance = ray.tMax;
-    // TODO: insert your code here
-    float minDistance = math::Limits<float>::inf();
-
-    auto it = _scene->getScenePrimitiveIterator();
-    auto end = _scene->getScenePrimitiveEnd();
-    auto obj = it->get()->sceneObject();
-    for (; it != end; it++)
-    {      
-      if (!it->get()->sceneObject()->visible) continue;
-      if (auto p = dynamic_cast<Primitive*>((Component*)(*it)))
-      {
-        auto t = p->transform();
-        auto o = t->worldToLocalMatrix().transform(ray.origin);
-        auto D = t->worldToLocalMatrix().transformVector(ray.direction);
-        auto d = math::inverse(D.length()); // ||s||
-
-        if (p->getbvh()->intersect({ o, D }, hit, d))
-        {
-          _numberOfHits++;
-          if (hit.distance < minDistance)
-          {
-            hit.object = p;
-            minDistance = hit.distance;
-          }
-        }
-      }
-    }
-    return hit.object != nullptr;
+    if (!_tlas->intersect(ray, hit))
+      return false;
+    context.numberOfHits++;
+    return true;
   }
 
-  Color
-    RayTracer::shade(const Ray& ray, Intersection& hit, int level, float weight)
+  RayTracer::SurfacePoint
+    RayTracer::surfacePoint(const Ray& ray, const Intersection& hit) const
     //[]---------------------------------------------------[]
-    //|  Shade a point P                                    |
+    //|  Surface point                                      |
     //|  @param the ray (input)                             |
     //|  @param information on intersection (input)         |
-    //|  @param recursion level                             |
-    //|  @param ray weight                                  |
-    //|  @return color at point P                           |
+    //|  @return hit point, offset along its normal, and    |
+    //|  interpolated normal in world coordinates           |
     //[]---------------------------------------------------[]
   {
-    // TODO: insert your code here
-
     auto triangles = hit.object->mesh()->data().triangles;
     auto normals = hit.object->mesh()->data().vertexNormals;
 
@@ -308,65 +1077,119 @@ namespace cg
     N = N.versor();
     auto p = ray.origin + hit.distance * ray.direction;
     p += rt_eps() * N;
+    return { p, N };
+  }
+
+  Ray
+    RayTracer::lightRay(int l, const vec3f& p) const
+    //[]---------------------------------------------------[]
+    //|  Light ray                                          |
+    //|  @param index of the light in the light list        |
+    //|  @param surface point                               |
+    //|  @return shadow ray from p towards the light        |
+    //[]---------------------------------------------------[]
+  {
+    const auto& lPos = _lights.position[l];
+    const auto& lDirection = _lights.direction[l];
+
+    return _lights.type[l] == Light::Type::Directional ? Ray{ p,-lDirection} : Ray{ p,lPos - p, 0, (lPos-p).length() };
+  }
 
-    auto material = hit.object->sceneObject()->primitive()->material;
+  // Returns d^n for the integer falloff and decay exponents
+  inline float
+    power(float d, int n)
+  {
+    auto x = 1.0f;
+
+    for (; n > 0; --n)
+      x *= d;
+    return x;
+  }
+
+  void
+    RayTracer::illuminate(Color& I,
+      const Material& material,
+      int l,
+      const SurfacePoint& s) const
+    //[]---------------------------------------------------[]
+    //|  Illuminate a point P                               |
+    //|  Adds to I the ambient and direct light of l at     |
+    //|  the (unshadowed) point                             |
+    //|  @param color at P (input/output)                   |
+    //|  @param material at P                               |
+    //|  @param index of the light in the light list        |
+    //|  @param surface point                               |
+    //[]---------------------------------------------------[]
+  {
+    const auto& p = s.p;
+    const auto& N = s.N;
+    const auto& lPos = _lights.position[l];
+    const auto& lDirection = _lights.direction[l];
+    const auto& color = _lights.color[l];
+    auto V = (_eye - p).versor();
+
+    Color Il;
+    vec3f Ll;
+    float dl;
+    float cosPhiL;
+
+    I += material.ambient * _scene->ambientLight;
+    switch (_lights.type[l])
+    {
+    case (0):// directional
+      Il = color;
+      Ll = -lDirection.versor();
+      break;
+    case(1):// point
+      Ll = (lDirection - p).versor();
+      dl = (p - lPos).length();
+      Il = color * (1.0f / power(dl, _lights.falloff[l]));
+      break;
+    case(2): // spot
+      Ll = (lPos - p).versor();
+      cosPhiL = lDirection.dot(-Ll);
+      dl = (p - lPos).length();
+      Il = cosPhiL < _lights.cosCutoff[l] ? Color::black : color * (1.0f / (power(dl, _lights.falloff[l]) * power(cosPhiL, _lights.decayExponent[l])));
+      break;
+    }
+    auto OdIl = material.diffuse * Il;
+    auto OsIl = material.spot * Il;
+    auto Rl = Ll - 2 * N.dot(Ll) * N;
+    I += OdIl * N.dot(Ll) + OsIl * pow(max(Rl.dot(V), 0.0f), material.shine);
+  }
+
+  Color
+    RayTracer::shade(Context& context,
+      const Ray& ray,
+      Intersection& hit,
+      int level,
+      float weight)
+    //[]---------------------------------------------------[]
+    //|  Shade a point P                                    |
+    //|  @param per-thread ray state                        |
+    //|  @param the ray (input)                             |
+    //|  @param information on intersection (input)         |
+    //|  @param recursion level                             |
+    //|  @param ray weight                                  |
+    //|  @return color at point P                           |
+    //[]---------------------------------------------------[]
+  {
+    auto s = surfacePoint(ray, hit);
+    const auto& material = hit.object->material;
     auto Or = material.specular;
     auto w = weight * std::max({ Or.r, Or.g, Or.b });
-    
-    auto it = _scene->getSceneLightsIterator();
-    auto end = _scene->getSceneLightsEnd();
 
     Color I = Color::black;
-    for (; it != end; it++)
-    {
-      auto l = it->get();
-      vec3f lPos = l->sceneObject()->transform()->position();
-      auto lDirection = l->sceneObject()->transform()->rotation() * vec3f(0, -1, 0);
-      auto ray = l->type() == Light::Type::Directional ? Ray{ p,-lDirection} : Ray{ p,lPos - p, 0, (lPos-p).length() };
-      auto camPos = Camera::current()->transform()->position();
-      auto V = (camPos - p).versor();
-
-      Color Il;
-      vec3f Ll;
-      float dl;
-      float gammaL;
-      float phiL;
-      
-      if (!shadow(ray))
-      {
-        I += material.ambient * _scene->ambientLight;
-        switch (l->type())
-        {
-        case (0):// directional
-          Il = l->color;
-          Ll = -lDirection.versor();
-          break;
-        case(1):// point
-          Ll = (lDirection - p).versor();
-          dl = (p - lPos).length();
-          Il = l->color * (1.0f / (pow(dl, l->fl())));
-          break;
-        case(2): // spot
-          gammaL = math::toRadians((float)l->gammaL());
-          Ll = (lPos - p).versor();
-          phiL = abs(acos(lDirection.dot(-Ll)));
-          dl = (p - lPos).length();
-          Il = gammaL < phiL ? Color::black : l->color * (1.0f / (pow(dl, l->fl()) * pow(cos(phiL), l->decayExponent())));
-          break;
-        }
-        auto OdIl = material.diffuse * Il;
-        auto OsIl = material.spot * Il;
-        auto Rl = Ll - 2 * N.dot(Ll) * N;
-        I += OdIl * N.dot(Ll) + OsIl * pow(max(Rl.dot(V), 0.0f), material.shine);
-
-      }
-    }
-    auto Rf = ray.direction - 2 * N.dot(ray.direction) * N;
+    for (int l = 0; l < _lights.size(); ++l)
+      if ((!_cullLights || _lights.reaches(l, s.p)) &&
+        !shadow(context, lightRay(l, s.p)))
+        illuminate(I, material, l, s);
+    auto Rf = ray.direction - 2 * s.N.dot(ray.direction) * s.N;
     if (Or != Color::black)
     {
       if (w > _minWeight)
       {
-        auto tr = trace({ p,Rf }, level + 1, w);
+        auto tr = trace(context, { s.p,Rf }, level + 1, w);
         if (tr != _scene->backgroundColor)
         {
           I += Or * tr;
@@ -388,15 +1211,21 @@ namespace cg
   }
 
   bool
-    RayTracer::shadow(const Ray& ray)
+    RayTracer::shadow(Context& context, const Ray& ray)
     //[]---------------------------------------------------[]
     //|  Verifiy if ray is a shadow ray                     |
+    //|  @param per-thread ray state                        |
     //|  @param the ray (input)                             |
     //|  @return true if the ray intersects an object       |
     //[]---------------------------------------------------[]
   {
-    Intersection hit;
-    return intersect(ray, hit);
+    context.numberOfShadowRays++;
+    RT_COUNT(shadowRays, 1);
+    // Any occluder closer than the light will do
+    if (!_tlas->occluded(ray))
+      return false;
+    RT_COUNT(occludedShadowRays, 1);
+    return true;
   }
 
 } // end namespace cg
@@ -33,15 +33,23 @@
 #ifndef __RayTracer_h
 #define __RayTracer_h
 
-#include "graphics/Image.h"
+#include "graphics/HDRBuffer.h"
 #include "Intersection.h"
+#include "RayStats.h"
 #include "Renderer.h"
+#include "TLAS.h"
+#include <atomic>
+#include <functional>
 
 namespace cg
 { // begin namespace cg
 
 #define MIN_WEIGHT float(0.001)
 #define MAX_RECURSION_LEVEL uint32_t(20)
+#define TILE_SIZE 32
+
+static_assert(cg::RayStats::maxDepth == MAX_RECURSION_LEVEL + 1,
+  "RayStats::maxDepth must match MAX_RECURSION_LEVEL");
 
 
 /////////////////////////////////////////////////////////////////////
@@ -51,6 +59,25 @@ namespace cg
 class RayTracer: public Renderer
 {
 public:
+  // Rays traced by the last render (all the samples of a progressive
+  // render), by kind
+  struct RayCounts
+  {
+    uint64_t primary;
+    uint64_t shadow;
+    uint64_t reflection;
+    uint64_t hits; // primary and reflection rays that hit an object
+
+    uint64_t total() const
+    {
+      return primary + shadow + reflection;
+    }
+
+  }; // RayCounts
+
+  // Called from the render threads when a tile of the frame is done
+  using TileFunction = std::function<void(int x, int y, int w, int h)>;
+
   // Constructor
   RayTracer(Scene&, Camera* = 0);
 
@@ -74,9 +101,163 @@ public:
     _minWeight = std::max(w, MIN_WEIGHT);
   }
 
+  auto numberOfThreads() const
+  {
+    return _numberOfThreads;
+  }
+
+  // Sets the number of render threads (0 means one per core)
+  void setNumberOfThreads(int n)
+  {
+    _numberOfThreads = std::max(n, 0);
+  }
+
+  auto packetTracing() const
+  {
+    return _packetTracing;
+  }
+
+  // Enables tracing of primary rays in packets of pixels
+  void setPacketTracing(bool enable)
+  {
+    _packetTracing = enable;
+  }
+
+  auto wavefrontTracing() const
+  {
+    return _wavefrontTracing;
+  }
+
+  // Enables tracing of the rays of each tile bounce by bounce, with the
+  // shadow and reflection rays of a bounce traced in batches
+  void setWavefrontTracing(bool enable)
+  {
+    _wavefrontTracing = enable;
+  }
+
+#ifdef RT_STATS
+  bool costHeatmap() const
+  {
+    return _costHeatmap;
+  }
+
+  // Enables a debug mode in which the color of each pixel shows the
+  // traversal work (see RayStats::work()) of its rays, from blue (none)
+  // to red (maxCost or more) on a logarithmic scale. Primary rays are
+  // traced one at a time, so that their work is told apart
+  void setCostHeatmap(bool enable, float maxCost = 2000)
+  {
+    _costHeatmap = enable;
+    _maxCost = std::max(maxCost, 1.0f);
+  }
+#endif // RT_STATS
+
+  auto numberOfSamples() const
+  {
+    return _numberOfSamples;
+  }
+
+  auto adaptiveThreshold() const
+  {
+    return _adaptiveThreshold;
+  }
+
+  // Enables adaptive sampling when threshold > 0. Every pixel gets the
+  // first minSamples (1 to 4) samples; after that, only the pixels
+  // whose luminance error, or contrast with a neighbor, exceeds
+  // threshold are sampled again. renderImage() then takes up to
+  // maxSamples samples per pixel
+  void setAdaptiveSampling(float threshold,
+    int minSamples = 4,
+    int maxSamples = 16)
+  {
+    _adaptiveThreshold = std::max(threshold, 0.0f);
+    _minSamples = std::min(std::max(minSamples, 1), 4);
+    _maxSamples = std::max(maxSamples, _minSamples);
+  }
+
+  // Returns true if no pixel needs more samples
+  bool converged() const
+  {
+    return _numberOfSamples > 0 && _activePixels == 0;
+  }
+
+  // Average number of samples per pixel accumulated so far
+  float averageSamples() const
+  {
+    return _W * _H > 0 ? float(_totalSamples) / (_W * _H) : 0;
+  }
+
+  RayCounts rayCounts() const
+  {
+    return {_numberOfPrimaryRays,
+      _numberOfShadowRays,
+      _numberOfRays - _numberOfPrimaryRays,
+      _numberOfHits};
+  }
+
+  // Statistics of the last render (all zero unless RT_STATS is
+  // defined), per render thread and in total
+  const auto& threadStats() const
+  {
+    return _threadStats;
+  }
+
+  RayStats stats() const
+  {
+    RayStats stats;
+
+    for (const auto& s : _threadStats)
+      stats.add(s);
+    return stats;
+  }
+
   void render();
   virtual void renderImage(Image&);
 
+  // Adds one jittered sample per pixel to the accumulated samples and
+  // writes their average to the image. The first sample is shot at the
+  // pixel centers, as in renderImage()
+  void renderSample(Image&);
+
+  // Same as above, but writes the pixels to frame and calls tileDone
+  // as each tile is finished. If cancel becomes true, the remaining
+  // tiles are skipped and the accumulated samples are discarded
+  void renderSample(ImageBuffer& frame,
+    const TileFunction& tileDone = nullptr,
+    const std::atomic<bool>* cancel = nullptr);
+
+  // Discards the accumulated samples (e.g. after a camera change)
+  void resetSamples()
+  {
+    _numberOfSamples = 0;
+  }
+
+  // Mean (unclamped) radiance of the pixels rendered so far
+  const HDRBuffer& radiance() const
+  {
+    return _radiance;
+  }
+
+  const auto& toneMapping() const
+  {
+    return _toneMapping;
+  }
+
+  // Sets how the radiance is converted to the pixels written by the
+  // next renders. Must not be called while rendering
+  void setToneMapping(const ToneMapping& toneMapping)
+  {
+    _toneMapping = toneMapping;
+  }
+
+  // Converts the radiance rendered so far to frame, which must have
+  // the size of the last render, without tracing any ray
+  void toneMap(ImageBuffer& frame) const
+  {
+    _radiance.toneMap(frame, _toneMapping);
+  }
+
 private:
   struct VRC
   {
@@ -85,24 +266,157 @@ private:
     vec3f n;
   };
 
+  // Ray of a wavefront bounce, spawned by the segment parent of the
+  // previous bounce (or shot from pixel parent of the tile, for pixel
+  // rays), with its path weight
+  struct PathRay
+  {
+    Ray ray;
+    int parent;
+    float weight;
+
+  }; // PathRay
+
+  // Color of a wavefront ray: its local shading plus, once the next
+  // bounces are resolved, the reflected color weighted by Or
+  struct PathSegment
+  {
+    Color color;
+    Color Or;
+    int parent;
+
+  }; // PathSegment
+
+  // Shading point of a hit, offset along the normal N
+  struct SurfacePoint
+  {
+    vec3f p;
+    vec3f N;
+
+  }; // SurfacePoint
+
+  // Scene lights flattened once per frame in SoA form, so that shading
+  // does not query the light components and their transforms. The
+  // direction of a light is its -y axis, and a spot lights the points
+  // p for which direction.dot((p - position).versor()) >= cosCutoff
+  struct LightList
+  {
+    std::vector<Light::Type> type;
+    std::vector<vec3f> position;
+    std::vector<vec3f> direction;
+    std::vector<Color> color;
+    std::vector<int> falloff;
+    std::vector<float> cosCutoff;
+    std::vector<int> decayExponent;
+
+    int size() const
+    {
+      return (int)type.size();
+    }
+
+    void clear();
+    void add(Light&);
+
+    // Returns false if light k cannot illuminate p
+    bool reaches(int k, const vec3f& p) const;
+
+    // Returns false if light k cannot illuminate any point of bounds
+    bool mayReach(int k, const Bounds3f& bounds) const;
+
+  }; // LightList
+
+  // Per-thread ray state
+  struct Context
+  {
+    Ray pixelRay;
+    uint64_t numberOfRays{}; // primary and reflection rays
+    uint64_t numberOfPrimaryRays{};
+    uint64_t numberOfShadowRays{};
+    uint64_t numberOfHits{};
+    RayStats stats;
+    // Wavefront queues, reused by the tiles of the thread
+    std::vector<int> lights; // lights that may reach the bounce hits
+    std::vector<PathRay> rays;
+    std::vector<PathRay> nextRays;
+    std::vector<std::pair<uint64_t, int>> keys;
+    std::vector<Intersection> hits;
+    std::vector<SurfacePoint> points;
+    std::vector<uint8_t> visible;
+    std::vector<PathSegment> segments[MAX_RECURSION_LEVEL + 1];
+
+  }; // Context
+
   uint32_t _maxRecursionLevel;
   float _minWeight;
-  uint64_t _numberOfRays;
-  uint64_t _numberOfHits;
-  Ray _pixelRay;
+  int _numberOfThreads{};
+  bool _packetTracing{true};
+  bool _wavefrontTracing{};
+#ifdef RT_STATS
+  bool _costHeatmap{};
+  float _maxCost{2000};
+#endif // RT_STATS
+  std::vector<Color> _samples;
+  std::vector<uint16_t> _sampleCounts;
+  std::vector<float> _luminances; // sums of sample luminances
+  std::vector<float> _squares; // sums of squared sample luminances
+  std::vector<uint8_t> _active; // pixels to sample in the next pass
+  int _numberOfSamples{};
+  int _activePixels{};
+  std::atomic<uint64_t> _totalSamples{};
+  float _adaptiveThreshold{};
+  int _minSamples{4};
+  int _maxSamples{16};
+  HDRBuffer _radiance;
+  ToneMapping _toneMapping;
+  Reference<TLAS> _tlas;
+  LightList _lights;
+  vec3f _eye; // position of the current camera, for specular terms
+  bool _cullLights; // true if unlit points get no ambient light
+  uint64_t _numberOfRays{};
+  uint64_t _numberOfPrimaryRays{};
+  uint64_t _numberOfShadowRays{};
+  uint64_t _numberOfHits{};
+  std::vector<RayStats> _threadStats;
   VRC _vrc;
   float _Vh;
   float _Vw;
   float _Ih;
   float _Iw;
 
-  void scan(Image& image);
-  void setPixelRay(float x, float y);
-  Color shoot(float x, float y);
-  bool intersect(const Ray&, Intersection&);
-  Color trace(const Ray& ray, uint32_t level, float weight);
-  Color shade(const Ray&, Intersection&, int, float);
-  bool shadow(const Ray&);
+  void begin(int w, int h);
+  void scan(ImageBuffer& frame,
+    const TileFunction& tileDone = nullptr,
+    const std::atomic<bool>* cancel = nullptr);
+  vec2f sampleOffset(int i, int j) const;
+  void writePixel(int i, int j, const Color&);
+  void writeAccumulated(int i, int j);
+  void updateActivePixels();
+
+  void resetRayCounts()
+  {
+    _numberOfRays = _numberOfPrimaryRays = 0;
+    _numberOfShadowRays = _numberOfHits = 0;
+    _threadStats.clear();
+  }
+
+  bool isActive(int i, int j) const
+  {
+    return _active.empty() || _active[size_t(j) * _W + i] != 0;
+  }
+  void setPixelRay(Context&, float x, float y);
+  Color shoot(Context&, float x, float y);
+  void shootPacket(Context&, int, int, int, int);
+  void shootWavefront(Context&, int, int, int, int);
+  void tracePrimary(Context&, int);
+  void traceShadows(Context&);
+  void sortRays(Context&);
+  bool intersect(Context&, const Ray&, Intersection&);
+  Color trace(Context&, const Ray& ray, uint32_t level, float weight);
+  Color shade(Context&, const Ray&, Intersection&, int, float);
+  SurfacePoint surfacePoint(const Ray&, const Intersection&) const;
+  Ray lightRay(int, const vec3f&) const;
+  void illuminate(Color&, const Material&, int, const SurfacePoint&) const;
+  bool shadow(Context&, const Ray&);
   Color background() const;
 
   vec3f imageToWindow(float x, float y) const
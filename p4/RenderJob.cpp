@@ -0,0 +1,172 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: RenderJob.cpp
+// ========
+// Source file for background render job.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#include "RenderJob.h"
+#include "core/ThreadPool.h"
+#include <chrono>
+#include <thread>
+
+namespace cg
+{ // begin namespace cg
+
+
+  /////////////////////////////////////////////////////////////////////
+  //
+  // RenderJob implementation
+  // =========
+  RenderJob::RenderJob(RayTracer& rayTracer,
+    int width,
+    int height,
+    int maxSamples) :
+    _rayTracer{ &rayTracer },
+    _frame{ width, height },
+    _maxSamples{ maxSamples }
+  {
+    // One slot per tile: a pass never publishes more tiles than that
+    // before the queue is drained, plus one for a tone-mapped frame
+    _capacity = ((width + TILE_SIZE - 1) / TILE_SIZE) *
+      ((height + TILE_SIZE - 1) / TILE_SIZE) + 1;
+    _queue.reset(new Slot[_capacity]);
+    _regions.reserve(_capacity);
+    _future = ThreadPool::global().submit([this]() { run(); });
+  }
+
+  RenderJob::~RenderJob()
+  {
+    cancel();
+    _future.wait();
+  }
+
+  void
+    RenderJob::push(int x, int y, int w, int h)
+  {
+    // Called concurrently by the render threads
+    auto& slot = _queue[_tail++ % _capacity];
+
+    slot.region = { x, y, w, h };
+    slot.ready.store(true, std::memory_order_release);
+  }
+
+  void
+    RenderJob::retone()
+  {
+    // Called with the tone mapping locked, when the frame is not being
+    // rendered or uploaded
+    _rayTracer->setToneMapping(_toneMapping);
+    _rayTracer->toneMap(_frame);
+    _retone = false;
+    push(0, 0, _frame.width(), _frame.height());
+  }
+
+  void
+    RenderJob::setToneMapping(const ToneMapping& toneMapping)
+  {
+    std::lock_guard<std::mutex> lock{ _toneMappingLock };
+
+    // The frame is converted by run() after the current pass or, once
+    // the job is finished, by the next update()
+    _toneMapping = toneMapping;
+    _retone = true;
+  }
+
+  void
+    RenderJob::run()
+  {
+    // Only raw pointers are used here: reference counts are not atomic
+    auto rayTracer = _rayTracer.get();
+    auto tileDone = [this](int x, int y, int w, int h)
+    {
+      push(x, y, w, h);
+    };
+    // Waits for the GL thread to upload the pushed regions of the frame
+    auto waitUpload = [this]()
+    {
+      while (!_cancel && _head != _tail)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    };
+
+    while (!_cancel &&
+      rayTracer->numberOfSamples() < _maxSamples &&
+      !rayTracer->converged())
+    {
+      rayTracer->renderSample(_frame, tileDone, &_cancel);
+      waitUpload();
+      if (!_cancel)
+        _numberOfSamples = rayTracer->numberOfSamples();
+      if (_retone && !_cancel)
+      {
+        {
+          std::lock_guard<std::mutex> lock{ _toneMappingLock };
+
+          retone();
+        }
+        // The next pass must not write the frame while it is uploaded
+        waitUpload();
+      }
+    }
+
+    std::lock_guard<std::mutex> lock{ _toneMappingLock };
+
+    if (_retone && !_cancel)
+      retone();
+    _finished = true;
+  }
+
+  int
+    RenderJob::update(GLImage& image)
+  {
+    if (_finished && _retone)
+    {
+      std::lock_guard<std::mutex> lock{ _toneMappingLock };
+
+      retone();
+    }
+
+    auto head = _head.load();
+
+    _regions.clear();
+    for (;; ++head)
+    {
+      auto& slot = _queue[head % _capacity];
+
+      if (!slot.ready.load(std::memory_order_acquire))
+        break;
+      _regions.push_back(slot.region);
+      slot.ready.store(false, std::memory_order_relaxed);
+    }
+    image.setData(_frame, _regions.data(), (int)_regions.size());
+    // Release the slots (and the frame tiles) to the render threads
+    _head = head;
+    return (int)_regions.size();
+  }
+
+} // end namespace cg
@@ -0,0 +1,127 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: RenderJob.h
+// ========
+// Class definition for background render job.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#ifndef __RenderJob_h
+#define __RenderJob_h
+
+#include "graphics/GLImage.h"
+#include "RayTracer.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+
+namespace cg
+{ // begin namespace cg
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// RenderJob: background render job class
+// =========
+// Renders samples with a ray tracer on the global thread pool. The
+// render threads publish finished tiles through a lock-free queue, and
+// the GL thread uploads them to an image by calling update() once per
+// frame. A new sample pass starts only after the tiles of the previous
+// one have been uploaded, so the frame is never written while read.
+class RenderJob: public SharedObject
+{
+public:
+  // Starts rendering the view of the ray tracer camera, which must
+  // have been set, until it has maxSamples samples per pixel (or, with
+  // adaptive sampling, until no pixel needs more samples)
+  RenderJob(RayTracer& rayTracer, int width, int height, int maxSamples);
+
+  // Destructor. Cancels the job and waits for the render threads.
+  ~RenderJob() override;
+
+  // Requests cancellation (returns immediately)
+  void cancel()
+  {
+    _cancel = true;
+  }
+
+  // Returns true if every sample pass has been rendered and uploaded
+  bool done() const
+  {
+    return _finished && _head == _tail;
+  }
+
+  // Returns the number of complete sample passes
+  int numberOfSamples() const
+  {
+    return _numberOfSamples;
+  }
+
+  // Changes the tone mapping of the frame without tracing any ray. The
+  // whole frame is converted again and uploaded by the next update(),
+  // or after the current pass if the job is not done
+  void setToneMapping(const ToneMapping& toneMapping);
+
+  // Uploads the tiles finished since the last call to image, which
+  // must have the size of the job frame. Must be called from the GL
+  // thread. Returns the number of uploaded tiles
+  int update(GLImage& image);
+
+private:
+  struct Slot
+  {
+    GLImage::Region region;
+    std::atomic<bool> ready{false};
+
+  }; // Slot
+
+  Reference<RayTracer> _rayTracer;
+  ImageBuffer _frame;
+  int _maxSamples;
+  std::unique_ptr<Slot[]> _queue;
+  int _capacity;
+  std::atomic<int> _head{0};
+  std::atomic<int> _tail{0};
+  std::atomic<int> _numberOfSamples{0};
+  std::atomic<bool> _cancel{false};
+  std::atomic<bool> _finished{false};
+  std::mutex _toneMappingLock;
+  ToneMapping _toneMapping;
+  std::atomic<bool> _retone{false};
+  std::vector<GLImage::Region> _regions;
+  std::future<void> _future;
+
+  void run();
+  void push(int x, int y, int w, int h);
+  void retone();
+
+}; // RenderJob
+
+} // end namespace cg
+
+#endif // __RenderJob_h
@@ -0,0 +1,337 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: RenderMain.cpp
+// ========
+// Source file for p4-render, the offline (no window) renderer.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#include "RayTracer.h"
+#include "Scenes.h"
+#include "core/Profiler.h"
+#include "geometry/MeshSweeper.h"
+#include "graphics/MemoryImage.h"
+#include "utils/ImageWriter.h"
+#include "utils/MeshReader.h"
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#ifdef _WIN32
+#define PATH_SEP '\\'
+#else
+#define PATH_SEP '/'
+#endif
+
+using namespace cg;
+
+namespace
+{ // begin namespace
+
+struct Options
+{
+  int scene{1};
+  std::string obj;
+  std::string assetDir;
+  std::string output{"out.png"};
+  std::string trace;
+  int width{1280};
+  int height{720};
+  int threads{};
+  int samples{1};
+  float adaptiveThreshold{};
+  int maxSamples{16};
+  ToneMapping toneMapping;
+  bool wavefront{};
+  bool noPackets{};
+  bool noCache{};
+  float heatmap{}; // max cost of the cost heatmap, if > 0
+
+}; // Options
+
+void
+usage(const char* program)
+{
+  fprintf(stderr,
+    "Usage: %s [options]\n"
+    "  -s, --scene n       render example scene n (1 to %d, default 1)\n"
+    "  --obj file          render the mesh in an OBJ or .mesh file instead\n"
+    "  --assets dir        asset directory (default: assets/ next to %s)\n"
+    "  -w, --width n       image width (default 1280)\n"
+    "  -h, --height n      image height (default 720)\n"
+    "  -t, --threads n     number of threads (default: all cores)\n"
+    "  --spp n             samples per pixel (default 1)\n"
+    "  --adaptive t [max]  adaptive sampling with threshold t\n"
+    "  --exposure ev       exposure in stops (default 0)\n"
+    "  --tonemap op        clamp, reinhard or aces (default clamp)\n"
+    "  --srgb              encode the pixels with the sRGB curve\n"
+    "  --wavefront         trace shadow and reflection rays in waves\n"
+    "  --no-packets        trace primary rays one at a time\n"
+    "  --no-cache          do not read or write BVH cache files\n"
+#ifdef RT_STATS
+    "  --heatmap [max]     render the traversal cost per pixel\n"
+#endif // RT_STATS
+    "  --trace file        write a Chrome trace of the run\n"
+    "  -o file             output image, .ppm, .png or .exr (default out.png)\n",
+    program, numberOfScenes, program);
+  exit(EXIT_FAILURE);
+}
+
+bool
+parseOptions(int argc, char** argv, Options& options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    auto arg = argv[i];
+    auto next = [&]()
+    {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+      return argv[++i];
+    };
+
+    if (!strcmp(arg, "-s") || !strcmp(arg, "--scene"))
+      options.scene = atoi(next());
+    else if (!strcmp(arg, "--obj"))
+      options.obj = next();
+    else if (!strcmp(arg, "--assets"))
+    {
+      options.assetDir = next();
+      if (options.assetDir.back() != '/' && options.assetDir.back() != '\\')
+        options.assetDir += '/';
+    }
+    else if (!strcmp(arg, "-w") || !strcmp(arg, "--width"))
+      options.width = atoi(next());
+    else if (!strcmp(arg, "-h") || !strcmp(arg, "--height"))
+      options.height = atoi(next());
+    else if (!strcmp(arg, "-t") || !strcmp(arg, "--threads"))
+      options.threads = atoi(next());
+    else if (!strcmp(arg, "--spp"))
+      options.samples = atoi(next());
+    else if (!strcmp(arg, "--adaptive"))
+    {
+      options.adaptiveThreshold = (float)atof(next());
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        options.maxSamples = atoi(next());
+    }
+    else if (!strcmp(arg, "--exposure"))
+      options.toneMapping.exposure = (float)atof(next());
+    else if (!strcmp(arg, "--tonemap"))
+    {
+      auto op = next();
+
+      if (!strcmp(op, "clamp"))
+        options.toneMapping.op = ToneMapping::Operator::Clamp;
+      else if (!strcmp(op, "reinhard"))
+        options.toneMapping.op = ToneMapping::Operator::Reinhard;
+      else if (!strcmp(op, "aces"))
+        options.toneMapping.op = ToneMapping::Operator::ACES;
+      else
+        return false;
+    }
+    else if (!strcmp(arg, "--srgb"))
+      options.toneMapping.sRGB = true;
+    else if (!strcmp(arg, "--wavefront"))
+      options.wavefront = true;
+    else if (!strcmp(arg, "--no-packets"))
+      options.noPackets = true;
+    else if (!strcmp(arg, "--no-cache"))
+      options.noCache = true;
+#ifdef RT_STATS
+    else if (!strcmp(arg, "--heatmap"))
+    {
+      options.heatmap = 2000;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        options.heatmap = (float)atof(next());
+    }
+#endif // RT_STATS
+    else if (!strcmp(arg, "--trace"))
+      options.trace = next();
+    else if (!strcmp(arg, "-o"))
+      options.output = next();
+    else
+      return false;
+  }
+  return options.width > 0 && options.height > 0 && options.samples > 0;
+}
+
+inline bool
+hasExtension(const std::string& filename, const char* ext)
+{
+  auto n = strlen(ext);
+
+  if (filename.size() < n)
+    return false;
+  for (auto s = filename.c_str() + filename.size() - n; *ext; ++s, ++ext)
+    if (tolower(*s) != *ext)
+      return false;
+  return true;
+}
+
+inline auto
+elapsed(std::chrono::steady_clock::time_point start)
+{
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now() - start).count();
+}
+
+} // end namespace
+
+int
+main(int argc, char** argv)
+{
+  Options options;
+
+  if (!parseOptions(argc, argv, options))
+    usage(argv[0]);
+  if (options.assetDir.empty())
+  {
+    // Same default as the one of Application
+    if (const auto slash = strrchr(argv[0], PATH_SEP))
+      options.assetDir = std::string{argv[0], slash} + "/assets/";
+    else
+      options.assetDir = "./assets/";
+  }
+
+  auto& output = options.output;
+
+  if (!hasExtension(output, ".ppm") &&
+    !hasExtension(output, ".png") &&
+    !hasExtension(output, ".exr"))
+  {
+    fprintf(stderr, "Unknown image format: %s\n", output.c_str());
+    return EXIT_FAILURE;
+  }
+  if (!options.trace.empty())
+  {
+    Profiler::setThreadName("Main");
+    Profiler::setEnabled(true);
+  }
+
+  std::map<std::string, Reference<TriangleMesh>> meshes;
+  auto loadMesh = [&](const std::string& name) -> TriangleMesh*
+  {
+    auto& mesh = meshes[name];
+
+    if (mesh == nullptr)
+    {
+      if (name == "Box")
+        mesh = MeshSweeper::makeBox();
+      else if (name == "Sphere")
+        mesh = MeshSweeper::makeSphere();
+      else
+      {
+        auto filename = options.assetDir + "meshes/" + name;
+        mesh = MeshReader::read(filename.c_str());
+      }
+    }
+    return mesh;
+  };
+  Reference<Scene> scene;
+  auto start = std::chrono::steady_clock::now();
+
+  if (options.obj.empty())
+    scene = buildScene(options.scene, loadMesh);
+  else if (auto mesh = MeshReader::read(options.obj.c_str()))
+  {
+    meshes[options.obj] = mesh;
+    scene = buildMeshScene(mesh, options.obj);
+  }
+  if (scene == nullptr)
+  {
+    if (options.obj.empty())
+      fprintf(stderr, "No such scene: %d\n", options.scene);
+    else
+      fprintf(stderr, "Unable to read %s\n", options.obj.c_str());
+    return EXIT_FAILURE;
+  }
+  makeBVHs(*scene,
+    options.noCache ? "" : options.assetDir + "meshes/cache/");
+  printf("Scene built in %.3f s\n", elapsed(start));
+
+  auto w = options.width;
+  auto h = options.height;
+  RayTracer rayTracer{*scene, Camera::current()};
+  MemoryImage image{w, h};
+
+  rayTracer.setImageSize(w, h);
+  rayTracer.setNumberOfThreads(options.threads);
+  rayTracer.setWavefrontTracing(options.wavefront);
+  rayTracer.setPacketTracing(!options.noPackets);
+  rayTracer.setToneMapping(options.toneMapping);
+#ifdef RT_STATS
+  rayTracer.setCostHeatmap(options.heatmap > 0, options.heatmap);
+#endif // RT_STATS
+  start = std::chrono::steady_clock::now();
+  if (options.adaptiveThreshold > 0)
+  {
+    rayTracer.setAdaptiveSampling(options.adaptiveThreshold,
+      std::min(options.samples, 4),
+      options.maxSamples);
+    rayTracer.renderImage(image);
+  }
+  else if (options.samples == 1)
+    rayTracer.renderImage(image);
+  else
+    for (int i = 0; i < options.samples; ++i)
+      rayTracer.renderSample(image);
+
+  auto time = elapsed(start);
+
+  printf("Rendered %dx%d (%.2f spp) in %.3f s\n",
+    w, h,
+    rayTracer.averageSamples(),
+    time);
+
+  bool ok;
+
+  if (hasExtension(output, ".exr"))
+    ok = ImageWriter::writeEXR(output.c_str(), rayTracer.radiance());
+  else if (hasExtension(output, ".png"))
+    ok = ImageWriter::writePNG(output.c_str(), image.buffer());
+  else
+    ok = ImageWriter::writePPM(output.c_str(), image.buffer());
+  if (!ok)
+  {
+    fprintf(stderr, "Unable to write %s\n", output.c_str());
+    return EXIT_FAILURE;
+  }
+  printf("Image written to %s\n", output.c_str());
+  if (!options.trace.empty())
+  {
+    if (!Profiler::writeTrace(options.trace.c_str()))
+    {
+      fprintf(stderr, "Unable to write %s\n", options.trace.c_str());
+      return EXIT_FAILURE;
+    }
+    printf("Trace written to %s\n", options.trace.c_str());
+  }
+  return EXIT_SUCCESS;
+}
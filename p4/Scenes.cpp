@@ -0,0 +1,904 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: Scenes.cpp
+// ========
+// Source file for the example scenes.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#include "Scenes.h"
+#include <filesystem>
+#include <map>
+
+namespace cg
+{ // begin namespace cg
+
+Light*
+createLight(Light::Type type)
+{
+  auto l = new Light();
+  l->setType(type);
+  l->fl(0);
+  l->setGammaL(45);
+  l->decayExponent(0);
+  return l;
+}
+
+inline Primitive*
+makePrimitive(const MeshProvider& meshes, const char* name)
+{
+  auto mesh = meshes(name);
+
+  return mesh != nullptr ? new Primitive(mesh, name) : nullptr;
+}
+
+static Scene*
+buildScene1(const MeshProvider& meshes)
+{
+  auto scene = new Scene{ "Scene 1" };
+
+  auto o = new SceneObject{ "Main Camera", scene };
+
+  auto camera = new Camera;
+  camera->setViewAngle(60);
+  camera->setClippingPlanes(0.01, 1000);
+  o->setParent(scene->root());
+  o->setCamera(camera);
+  o->transform()->setLocalPosition(vec3f(0, 4.8, 3.7));
+  o->transform()->rotate(vec3f(-50, 0, 0));
+
+  o->addComponent(camera);
+
+  scene->root()->addChild(o);
+  Camera::setCurrent(camera);
+
+  o = new SceneObject{ "box1", scene };
+
+  auto p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(0.4, 0.3, 0.4));
+  o->transform()->setLocalPosition(vec3f(0, 2.3, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "box2", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  scene->root()->addChild(o);
+
+  auto l = createLight(cg::Light::Type::Spot);
+  o = new SceneObject{ "light0", scene };
+  l->color = Color::red;
+  l->setGammaL(10);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(1, 10, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Spot);
+  o = new SceneObject{ "light1", scene };
+  l->color = Color::green;
+  l->setGammaL(10);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(-1, 10, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Directional);
+  o = new SceneObject{ "light2", scene };
+  l->color = Color::blue;
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->rotate(vec3f(90, 0, 0));
+  scene->root()->addChild(o);
+  return scene;
+}
+
+static Scene*
+buildScene2(const MeshProvider& meshes)
+{
+  auto scene = new Scene{ "Scene 2" };
+
+  auto o = new SceneObject{ "Main Camera", scene };
+
+  auto camera = new Camera;
+  camera->setViewAngle(60);
+  camera->setClippingPlanes(0.01, 1000);
+  o->setParent(scene->root());
+  o->setCamera(camera);
+  o->transform()->setLocalPosition(vec3f(0, 14, 0));
+  o->transform()->rotate(vec3f(-90, 0, 0));
+
+  o->addComponent(camera);
+
+  scene->root()->addChild(o);
+  Camera::setCurrent(camera);
+
+  o = new SceneObject{ "ground", scene };
+
+  auto p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(7, 0.01, 7));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "base1", scene };
+  o->setParent(scene->root());
+  p1 = makePrimitive(meshes, "Box");
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(4, 0.25, 4));
+  o->transform()->setLocalPosition(vec3f(0, 0.25, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "base2", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(3.75, 0.5, 3.75));
+  o->transform()->setLocalPosition(vec3f(0, 0.5, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "base3", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(3.5, 0.75, 3.5));
+  o->transform()->setLocalPosition(vec3f(0, 0.75, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "base4", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(3.25, 1, 3.25));
+  o->transform()->setLocalPosition(vec3f(0, 1, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "base5", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(3.0, 1.25, 3.0));
+  o->transform()->setLocalPosition(vec3f(0, 1.25, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "base6", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(2.75, 1.5, 2.75));
+  o->transform()->setLocalPosition(vec3f(0, 1.5, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "base7", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(2.5, 1.75, 2.5));
+  o->transform()->setLocalPosition(vec3f(0, 1.75, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "base8", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(2.0, 2.0, 2.0));
+  o->transform()->setLocalPosition(vec3f(0, 2.0, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "stair1", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(0.1, 1.7, 0.5));
+  o->transform()->setLocalPosition(vec3f(3.4, 1.5, 0));
+  o->transform()->rotate(vec3f(0, 0, 27));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "stair2", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(0.1, 1.7, 0.5));
+  o->transform()->setLocalPosition(vec3f(-3.4, 1.5, 0));
+  o->transform()->rotate(vec3f(0, 0, -27));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "stair3", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(0.5, 1.7, 0.1));
+  o->transform()->setLocalPosition(vec3f(0, 1.5, -3.4));
+  o->transform()->rotate(vec3f(27, 0, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "stair4", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(0.5, 1.7, 0.1));
+  o->transform()->setLocalPosition(vec3f(0, 1.5, 3.4));
+  o->transform()->rotate(vec3f(-27, 0, 0));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "cupula", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(1.5, 1.5, 1.5));
+  o->transform()->setLocalPosition(vec3f(0, 3.5, 0));
+  scene->root()->addChild(o);
+
+  //lights
+  auto l = createLight(cg::Light::Type::Spot);
+  o = new SceneObject{ "light0", scene };
+  l->color = vec4f(0.4823, 0.4823, 0.4823, 1);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(0, 5.5, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Spot);
+  o = new SceneObject{ "light1", scene };
+  l->color = vec4f(1, 0, 0, 1);
+  l->setGammaL(15.f);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(0, 5.9, -0.5));
+  o->transform()->rotate(vec3f(-38, 0, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Spot);
+  o = new SceneObject{ "light2", scene };
+  l->color = vec4f(0, 0, 1, 1);
+  l->setGammaL(15.f);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(0, 5.9, 0.5));
+  o->transform()->rotate(vec3f(38, 0, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Spot);
+  o = new SceneObject{ "light3", scene };
+  l->color = vec4f(0, 1, 0, 1);
+  l->setGammaL(15.f);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(0.5, 5.9, 0));
+  o->transform()->rotate(vec3f(0, 0, -38));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Directional);
+  o = new SceneObject{ "light4", scene };
+  l->color = vec4f(1, 0, 0, 1);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->rotate(vec3f(90, 0, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Directional);
+  o = new SceneObject{ "light5", scene };
+  l->color = vec4f(0, 0, 1, 1);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->rotate(vec3f(0, 0, 90));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Point);
+  o = new SceneObject{ "light6", scene };
+  l->color = vec4f(1, 1, 1, 1);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(0, 3.3, 0));
+  scene->root()->addChild(o);
+
+  camera = new Camera;
+  camera->setViewAngle(60);
+  camera->setClippingPlanes(0.01, 1000);
+
+  o = new SceneObject{ "camera0", scene };
+  o->setCamera(camera);
+  o->setParent(scene->root());
+  o->transform()->setLocalPosition(vec3f(-6, 6.8, 6));
+  o->transform()->rotate(vec3f(-37, -45, 0));
+  camera->setProjectionType(Camera::ProjectionType::Parallel);
+
+  o->addComponent(camera);
+
+  scene->root()->addChild(o);
+  Camera::setCurrent(camera);
+  return scene;
+}
+
+static Scene*
+buildScene3(const MeshProvider& meshes)
+{
+  auto scene = new Scene{ "Scene 3" };
+
+  auto o = new SceneObject{ "Main Camera", scene };
+
+  auto camera = new Camera;
+  camera->setViewAngle(60);
+  camera->setClippingPlanes(0.01, 1000);
+  o->setParent(scene->root());
+  o->setCamera(camera);
+  o->transform()->setLocalPosition(vec3f(0, 9.8, 0));
+  o->transform()->rotate(vec3f(-20, 135, 0));
+
+  o->addComponent(camera);
+
+  scene->root()->addChild(o);
+  Camera::setCurrent(camera);
+
+  o = new SceneObject{ "ground", scene };
+  auto p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(10, 0.1, 10));
+  o->transform()->setLocalPosition(vec3f(0, -0.2, 0));
+  o->primitive()->material.diffuse = Color::gray;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "wall0", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(10, 10, 0.1));
+  o->transform()->setLocalPosition(vec3f(0, 0, -10));
+  o->primitive()->material.diffuse = Color::black;
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "wall1", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(10, 10, 0.1));
+  o->transform()->setLocalPosition(vec3f(0, 0, 10));
+  o->primitive()->material.diffuse = Color::black;
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "wall2", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(0.1, 10, 10));
+  o->transform()->setLocalPosition(vec3f(-10, 0, 0));
+  o->primitive()->material.diffuse = Color::black;
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "wall3", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(0.1, 10, 10));
+  o->transform()->setLocalPosition(vec3f(10, 0, 0));
+  o->primitive()->material.diffuse = Color::black;
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "roof", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(10, 0.1, 10));
+  o->transform()->setLocalPosition(vec3f(0, 10, 0));
+  o->primitive()->material.diffuse = Color::cyan;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball1", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(0, 1, 1));
+  o->primitive()->material.diffuse = Color::blue;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball2", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(5, 1, 2));
+  o->primitive()->material.diffuse = Color::magenta;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball3", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(-5, 1, 3));
+  o->primitive()->material.diffuse = Color::yellow;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball4", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(8, 1, 4));
+  o->primitive()->material.diffuse = Color::green;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball5", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(-8, 1, 5));
+  o->primitive()->material.diffuse = Color::darkGray;
+  scene->root()->addChild(o);
+
+  auto l = createLight(cg::Light::Type::Point);
+  o = new SceneObject{ "light0", scene };
+  l->color = Color::white;
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(0, 6.3, 0));
+  scene->root()->addChild(o);
+  return scene;
+}
+
+static Scene*
+buildScene4(const MeshProvider& meshes)
+{
+  auto scene = new Scene{ "Scene 4" };
+
+  auto o = new SceneObject{ "Main Camera", scene };
+
+  auto camera = new Camera;
+  camera->setViewAngle(60);
+  camera->setClippingPlanes(0.01, 1000);
+  o->setParent(scene->root());
+  o->setCamera(camera);
+  o->transform()->setLocalPosition(vec3f(0, 0, 6));
+  o->transform()->rotate(vec3f(0, 0, 0));
+
+  o->addComponent(camera);
+
+  scene->root()->addChild(o);
+  Camera::setCurrent(camera);
+
+  o = new SceneObject{ "wall", scene };
+
+  auto p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(10, 10, 0.1));
+  o->transform()->setLocalPosition(vec3f(0, 0, -9.7));
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "skull", scene };
+  o->setParent(scene->root());
+  o->transform()->setLocalScale(vec3f(0.1, 0.1, 0.1));
+  o->transform()->rotate(vec3f(-90, 0, 0));
+
+  if (auto p = makePrimitive(meshes, "skull.obj"))
+    o->addComponent(p);
+  scene->root()->addChild(o);
+
+  auto l = createLight(cg::Light::Type::Spot);
+  o = new SceneObject{ "light0", scene };
+  l->color = Color::red;
+  l->setGammaL(28);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(2, -1.7, 4.5));
+  o->transform()->rotate(vec3f(110, 25, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Spot);
+  o = new SceneObject{ "light1", scene };
+  l->color = Color::green;
+  l->setGammaL(28);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(-2, -1.7, 4.5));
+  o->transform()->rotate(vec3f(110, -25, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Spot);
+  o = new SceneObject{ "light2", scene };
+  l->color = Color::green;
+  l->setGammaL(28);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(-1, 10, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Directional);
+  o = new SceneObject{ "light3", scene };
+  l->color = Color::darkGray;
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->rotate(vec3f(90, 0, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Spot);
+  o = new SceneObject{ "light4", scene };
+  l->color = Color::blue;
+  l->setGammaL(10);
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(0, 5.9, 9.1));
+  o->transform()->rotate(vec3f(61, 0, 0));
+  scene->root()->addChild(o);
+  return scene;
+}
+
+static Scene*
+buildScene5(const MeshProvider& meshes)
+{
+  auto scene = new Scene{ "Scene 5" };
+
+  auto o = new SceneObject{ "Main Camera", scene };
+
+  auto camera = new Camera;
+  camera->setViewAngle(60);
+  camera->setClippingPlanes(0.01, 1000);
+  o->setParent(scene->root());
+  o->setCamera(camera);
+  o->transform()->setLocalPosition(vec3f(0, 0, 6));
+  o->transform()->rotate(vec3f(0, 0, 0));
+
+  o->addComponent(camera);
+
+  scene->root()->addChild(o);
+  Camera::setCurrent(camera);
+
+  o = new SceneObject{ "box10", scene };
+  auto p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(5, 5, 0.1));
+  o->transform()->setLocalPosition(vec3f(0, 0, -5));
+  o->primitive()->material.diffuse = Color::red;
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "box11", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(5, 0, 0));
+  o->transform()->setLocalScale(vec3f(0.1, 5, 5));
+
+  o->primitive()->material.diffuse = Color::green;
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "box12", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(0.1, 5, 5));
+  o->transform()->setLocalPosition(vec3f(-5, 0, 0));
+  o->primitive()->material.diffuse = Color::blue;
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "box18", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(1, 1, 1));
+  o->transform()->setLocalPosition(vec3f(0, 0, -4));
+  o->transform()->rotate(vec3f(45, 45, 45));
+  o->primitive()->material.diffuse.setRGB(255,255,0);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "box19", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(5, 0.1, 5));
+  o->transform()->rotate(vec3f(-45, 0, 0));
+  o->transform()->setLocalPosition(vec3f(0, 2.5, -5));
+  o->primitive()->material.diffuse.setRGB(101,0,179);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "box20", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(5, 0.1, 5));
+  o->transform()->setLocalPosition(vec3f(0, -2.5, -5));
+  o->transform()->rotate(vec3f(45, 0, 0));
+  o->primitive()->material.diffuse.setRGB(255,255,0);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "box23", scene };
+  p1 = makePrimitive(meshes, "Box");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalScale(vec3f(1, 1, 1));
+  o->transform()->rotate(vec3f(0, 5.3, 0));
+  o->transform()->setLocalPosition(vec3f(0, 0, -4));
+  o->primitive()->material.diffuse.setRGB(12,126,232);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball16", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(4, 0, -4));
+  o->primitive()->material.diffuse.setRGB(97, 0, 253);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball17", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(-4, 0, -4));
+  o->primitive()->material.diffuse.setRGB(21, 195, 77);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball21", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(-4, 0, 0));
+  o->primitive()->material.diffuse.setRGB(255, 255, 0);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball22", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(4, 0, 0));
+  o->primitive()->material.diffuse.setRGB(25, 137, 255);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball24", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(-5, 3, -4));
+  o->primitive()->material.diffuse.setRGB(232, 106, 2);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball25", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(5, 3, -4));
+  o->primitive()->material.diffuse.setRGB(12, 232, 200);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball26", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(5, -3, -4));
+  o->primitive()->material.diffuse.setRGB(212, 0, 255);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  o = new SceneObject{ "ball27", scene };
+  p1 = makePrimitive(meshes, "Sphere");
+  o->setParent(scene->root());
+  o->addComponent(p1);
+  o->transform()->setLocalPosition(vec3f(-5, -3, -4));
+  o->primitive()->material.diffuse.setRGB(255, 40, 0);
+  o->primitive()->material.specular = Color::white;
+  scene->root()->addChild(o);
+
+  auto l = createLight(cg::Light::Type::Point);
+  o = new SceneObject{ "light0", scene };
+  l->color = Color::white;
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(0, 0, 0));
+  scene->root()->addChild(o);
+  return scene;
+}
+
+Scene*
+buildScene(int n, const MeshProvider& meshes)
+{
+  switch (n)
+  {
+  case 1: return buildScene1(meshes);
+  case 2: return buildScene2(meshes);
+  case 3: return buildScene3(meshes);
+  case 4: return buildScene4(meshes);
+  case 5: return buildScene5(meshes);
+  }
+  return nullptr;
+}
+
+Scene*
+buildGridScene(int n, const MeshProvider& meshes)
+{
+  auto scene = new Scene{ "Grid" };
+  auto size = 1.5f * n;
+
+  auto o = new SceneObject{ "Main Camera", scene };
+
+  auto camera = new Camera;
+  camera->setViewAngle(60);
+  camera->setClippingPlanes(0.01f, 10 * size);
+  o->setParent(scene->root());
+  o->setCamera(camera);
+  o->transform()->setLocalPosition(vec3f(0, 0.8f * size, 0.9f * size));
+  o->transform()->rotate(vec3f(-42, 0, 0));
+  o->addComponent(camera);
+  scene->root()->addChild(o);
+  Camera::setCurrent(camera);
+
+  o = new SceneObject{ "floor", scene };
+  o->setParent(scene->root());
+  o->addComponent(makePrimitive(meshes, "Box"));
+  o->transform()->setLocalScale(vec3f(size, 0.1f, size));
+  o->transform()->setLocalPosition(vec3f(0, -0.6f, 0));
+  scene->root()->addChild(o);
+
+  // Every other ball is a mirror, so that about half of the hits spawn
+  // reflection rays
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j)
+    {
+      auto p = makePrimitive(meshes, "Sphere");
+      auto& material = p->material;
+
+      o = new SceneObject{ "ball", scene };
+      o->setParent(scene->root());
+      o->addComponent(p);
+      o->transform()->setLocalScale(vec3f(0.5f));
+      o->transform()->setLocalPosition(vec3f(1.5f * i + 0.75f - 0.75f * n,
+        0,
+        1.5f * j + 0.75f - 0.75f * n));
+      material.diffuse = Color{ float(i) / n, float(j) / n, 0.5f };
+      material.specular = (i + j) % 2 ? Color::gray : Color::black;
+      scene->root()->addChild(o);
+    }
+
+  auto l = createLight(cg::Light::Type::Point);
+  o = new SceneObject{ "light0", scene };
+  l->color = Color::white;
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->setLocalPosition(vec3f(0, size, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Directional);
+  o = new SceneObject{ "light1", scene };
+  l->color = Color::darkGray;
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->rotate(vec3f(60, 30, 0));
+  scene->root()->addChild(o);
+  return scene;
+}
+
+Scene*
+buildMeshScene(TriangleMesh* mesh, const std::string& meshName)
+{
+  auto scene = new Scene{ meshName.c_str() };
+
+  auto o = new SceneObject{ meshName.c_str(), scene };
+
+  o->setParent(scene->root());
+  o->addComponent(new Primitive(mesh, meshName));
+  scene->root()->addChild(o);
+
+  // Frame the bounding sphere of the mesh with a 60 degree view angle
+  auto bounds = mesh->bounds();
+  auto radius = std::max(0.5f * bounds.diagonalLength(), 0.01f);
+  auto distance = 2 * radius;
+
+  o = new SceneObject{ "Main Camera", scene };
+
+  auto camera = new Camera;
+  camera->setViewAngle(60);
+  camera->setClippingPlanes(0.01f * radius, distance + 2 * radius);
+  o->setParent(scene->root());
+  o->setCamera(camera);
+  o->transform()->setLocalPosition(bounds.center() + vec3f(0, 0, distance));
+  o->addComponent(camera);
+  scene->root()->addChild(o);
+  Camera::setCurrent(camera);
+
+  auto l = createLight(cg::Light::Type::Directional);
+  o = new SceneObject{ "light0", scene };
+  l->color = Color::white;
+  o->setParent(scene->root());
+  o->addComponent(l);
+  o->transform()->rotate(vec3f(90, 0, 0));
+  scene->root()->addChild(o);
+
+  l = createLight(cg::Light::Type::Directional);
+  o = new SceneObject{ "light1", scene };
+  l->color = Color::darkGray;
+  o->setParent(scene->root());
+  o->addComponent(l);
+  scene->root()->addChild(o);
+  return scene;
+}
+
+BVH*
+cachedBVH(TriangleMesh& mesh, const std::string& cacheDir)
+{
+  constexpr auto maxTrisPerNode = 16;
+  constexpr auto splitMethod = BVH::SplitMethod::SAH;
+  if (cacheDir.empty())
+    return new BVH{mesh, maxTrisPerNode, splitMethod};
+
+  auto key = BVH::cacheKey(mesh, maxTrisPerNode, splitMethod);
+  char name[32];
+
+  snprintf(name, sizeof name, "%016llx.bvh", (unsigned long long)key);
+
+  std::filesystem::path path{cacheDir};
+  auto filename = (path / name).string();
+
+  if (auto bvh = BVH::load(mesh, filename.c_str(), maxTrisPerNode, splitMethod))
+    return bvh;
+
+  auto bvh = new BVH{mesh, maxTrisPerNode, splitMethod};
+  std::error_code error;
+
+  // The cache is an optimization, so failing to write it is harmless
+  if (std::filesystem::create_directories(path, error) || !error)
+    bvh->save(filename.c_str());
+  return bvh;
+}
+
+void
+makeBVHs(Scene& scene, const std::string& cacheDir)
+{
+  std::map<TriangleMesh*, BVH*> bvhs;
+  auto end = scene.getScenePrimitiveEnd();
+
+  for (auto it = scene.getScenePrimitiveIterator(); it != end; it++)
+    if (auto p = dynamic_cast<Primitive*>((Component*)(*it)))
+    {
+      auto mesh = p->mesh();
+
+      if (mesh == nullptr || p->getbvh() != nullptr)
+        continue;
+
+      auto& bvh = bvhs[mesh];
+
+      if (bvh == nullptr)
+        bvh = cachedBVH(*mesh, cacheDir);
+      p->setbvh(bvh);
+    }
+}
+
+} // end namespace cg
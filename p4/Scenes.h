@@ -0,0 +1,76 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: Scenes.h
+// ========
+// Function definitions for the example scenes.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#ifndef __Scenes_h
+#define __Scenes_h
+
+#include "Scene.h"
+#include <functional>
+#include <string>
+
+namespace cg
+{ // begin namespace cg
+
+// Returns the mesh named name ("Box", "Sphere", or the file name of a
+// mesh asset), or nullptr if there is none
+using MeshProvider = std::function<TriangleMesh*(const std::string& name)>;
+
+// Creates a light with the default parameters of the editor
+Light* createLight(Light::Type type);
+
+// Number of example scenes
+constexpr auto numberOfScenes = 5;
+
+// Builds example scene n (1 to numberOfScenes), whose main camera is
+// made the current one. Returns nullptr if there is no such scene
+Scene* buildScene(int n, const MeshProvider& meshes);
+
+// Builds a scene with n x n balls on a floor, half of them mirrors, to
+// scale the example scenes up (e.g., for benchmarks)
+Scene* buildGridScene(int n, const MeshProvider& meshes);
+
+// Builds a scene with a single primitive for mesh, a camera in front of
+// it and two directional lights
+Scene* buildMeshScene(TriangleMesh* mesh, const std::string& meshName);
+
+// Loads the BVH of mesh from cacheDir, or builds and caches it there.
+// Cached trees are named after the content of the mesh. If cacheDir is
+// empty, the tree is always built and not cached
+BVH* cachedBVH(TriangleMesh& mesh, const std::string& cacheDir);
+
+// Sets the BVHs (see cachedBVH()) of the primitives of scene that have
+// none. Primitives sharing a mesh share its BVH
+void makeBVHs(Scene& scene, const std::string& cacheDir);
+
+} // end namespace cg
+
+#endif // __Scenes_h
@@ -0,0 +1,389 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: TLAS.cpp
+// ========
+// Source file for top-level acceleration structure.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#include "TLAS.h"
+#include "core/Profiler.h"
+#include "RayStats.h"
+#include "Scene.h"
+#include <algorithm>
+
+namespace cg
+{ // begin namespace cg
+
+  /////////////////////////////////////////////////////////////////////
+  //
+  // TLAS implementation
+  // ====
+  TLAS::TLAS(Scene& scene, int maxInstancesPerNode) :
+    _maxInstancesPerNode{ maxInstancesPerNode }
+  {
+    PROFILE_ZONE("TLAS::build");
+
+    collectSources(scene, _sources);
+
+    auto n = (int)_sources.size();
+
+    _instances.resize(n);
+    for (int i = 0; i < n; ++i)
+      setInstance(_instances[i], _sources[i], i);
+    if (n > 0)
+    {
+      _nodes.reserve(2 * n);
+      makeNode(0, n);
+    }
+    _buildCost = computeCost();
+  }
+
+  void
+    TLAS::collectSources(Scene& scene, std::vector<Source>& sources)
+  {
+    auto it = scene.getScenePrimitiveIterator();
+    auto end = scene.getScenePrimitiveEnd();
+
+    sources.clear();
+    for (; it != end; it++)
+    {
+      if (!it->get()->sceneObject()->visible)
+        continue;
+      if (auto p = dynamic_cast<Primitive*>((Component*)(*it)))
+      {
+        auto bvh = p->getbvh();
+
+        if (bvh != nullptr && !bvh->bounds().empty())
+          sources.push_back({ p, bvh });
+      }
+    }
+  }
+
+  void
+    TLAS::setInstance(Instance& instance, const Source& source, int index)
+  {
+    auto t = source.primitive->transform();
+    Bounds3f bounds{ source.bvh->bounds(), t->localToWorldMatrix() };
+
+    instance = { source.primitive,
+      source.bvh,
+      t->worldToLocalMatrix(),
+      bounds,
+      bounds.center(),
+      index };
+  }
+
+  int
+    TLAS::makeNode(int start, int end)
+  {
+    auto index = (int)_nodes.size();
+    Bounds3f bounds;
+    Bounds3f centroidBounds;
+
+    for (int i = start; i < end; ++i)
+    {
+      bounds.inflate(_instances[i].bounds);
+      centroidBounds.inflate(_instances[i].centroid);
+    }
+    _nodes.push_back({ bounds, start, end - start });
+    if (end - start <= _maxInstancesPerNode)
+      return index;
+
+    auto s = centroidBounds.size();
+    auto dim = s.x > s.y && s.x > s.z ? 0 : (s.y > s.z ? 1 : 2);
+
+    if (s[dim] <= 0)
+      return index;
+
+    auto mid = (start + end) / 2;
+
+    std::nth_element(_instances.begin() + start,
+      _instances.begin() + mid,
+      _instances.begin() + end,
+      [dim](const Instance& a, const Instance& b)
+      {
+        return a.centroid[dim] < b.centroid[dim];
+      });
+    // The first child immediately follows its parent
+    makeNode(start, mid);
+
+    auto second = makeNode(mid, end);
+
+    _nodes[index].offset = second;
+    _nodes[index].count = 0;
+    return index;
+  }
+
+  float
+    TLAS::computeCost() const
+  {
+    if (_nodes.empty())
+      return 0;
+
+    auto area = _nodes[0].bounds.area();
+    auto cost = 0.0f;
+
+    if (area <= 0)
+      return float(_instances.size());
+    // Same weights as the SAH cost of the BVH
+    for (const auto& node : _nodes)
+      cost += (node.count > 0 ? float(node.count) : 0.125f) *
+        node.bounds.area();
+    return cost / area;
+  }
+
+  bool
+    TLAS::refit(Scene& scene, float maxCostRatio)
+  {
+    std::vector<Source> sources;
+
+    collectSources(scene, sources);
+    if (sources.size() != _sources.size() ||
+      !std::equal(sources.begin(),
+        sources.end(),
+        _sources.begin(),
+        [](const Source& a, const Source& b)
+        {
+          return a.primitive == b.primitive && a.bvh == b.bvh;
+        }))
+      return false;
+    for (auto& instance : _instances)
+      setInstance(instance, _sources[instance.source], instance.source);
+    // Children follow their parent in the node array
+    for (auto i = (int)_nodes.size(); i-- > 0;)
+    {
+      auto& node = _nodes[i];
+      Bounds3f bounds;
+
+      if (node.count > 0)
+        for (int j = node.offset, e = j + node.count; j < e; ++j)
+          bounds.inflate(_instances[j].bounds);
+      else
+      {
+        bounds.inflate(_nodes[i + 1].bounds);
+        bounds.inflate(_nodes[node.offset].bounds);
+      }
+      node.bounds = bounds;
+    }
+    return computeCost() <= maxCostRatio * _buildCost;
+  }
+
+  Bounds3f
+    TLAS::bounds() const
+  {
+    return _nodes.empty() ? Bounds3f{} : _nodes[0].bounds;
+  }
+
+  bool
+    TLAS::intersect(const Ray& ray, Intersection& hit) const
+  {
+    if (_nodes.empty())
+      return false;
+
+    int stack[64];
+    int top = 0;
+    float tMin, tMax;
+
+    stack[top++] = 0;
+    while (top > 0)
+    {
+      const auto& node = _nodes[stack[--top]];
+
+      RT_COUNT(nodesVisited, 1);
+      RT_COUNT(boxTests, 1);
+      // World rays have unit direction, so t is a distance
+      if (!node.bounds.intersect(ray, tMin, tMax) ||
+        tMax < 0 ||
+        tMin > hit.distance)
+        continue;
+      if (node.count == 0)
+      {
+        stack[top++] = node.offset;
+        stack[top++] = int(&node - _nodes.data()) + 1;
+        continue;
+      }
+      for (int i = node.offset, e = i + node.count; i < e; ++i)
+      {
+        const auto& instance = _instances[i];
+
+        RT_COUNT(boxTests, node.count > 1);
+        if (node.count > 1 &&
+          (!instance.bounds.intersect(ray, tMin, tMax) || tMin > hit.distance))
+          continue;
+
+        // Transform the ray only when the instance box is hit
+        const auto& m = instance.worldToLocal;
+        auto o = m.transform(ray.origin);
+        auto D = m.transformVector(ray.direction);
+        auto d = math::inverse(D.length()); // ||s||
+
+        if (instance.bvh->intersect({ o, D }, hit, d))
+          hit.object = instance.primitive;
+      }
+    }
+    return hit.object != nullptr;
+  }
+
+  bool
+    TLAS::occluded(const Ray& ray) const
+  {
+    if (_nodes.empty())
+      return false;
+
+    int stack[64];
+    int top = 0;
+    float tMin, tMax;
+
+    stack[top++] = 0;
+    while (top > 0)
+    {
+      const auto& node = _nodes[stack[--top]];
+
+      RT_COUNT(nodesVisited, 1);
+      RT_COUNT(boxTests, 1);
+      if (!node.bounds.intersect(ray, tMin, tMax) ||
+        tMax < 0 ||
+        tMin > ray.tMax)
+        continue;
+      if (node.count == 0)
+      {
+        stack[top++] = node.offset;
+        stack[top++] = int(&node - _nodes.data()) + 1;
+        continue;
+      }
+      for (int i = node.offset, e = i + node.count; i < e; ++i)
+      {
+        const auto& instance = _instances[i];
+
+        RT_COUNT(boxTests, node.count > 1);
+        if (node.count > 1 &&
+          (!instance.bounds.intersect(ray, tMin, tMax) || tMin > ray.tMax))
+          continue;
+
+        const auto& m = instance.worldToLocal;
+        auto o = m.transform(ray.origin);
+        auto D = m.transformVector(ray.direction);
+        auto d = math::inverse(D.length()); // ||s||
+
+        if (instance.bvh->occluded({ o, D }, d, ray.tMax))
+          return true;
+      }
+    }
+    return false;
+  }
+
+  uint32_t
+    TLAS::intersect(const RayPacket& packet,
+      Intersection hit[],
+      uint32_t mask) const
+  {
+    if (_nodes.empty())
+      return 0;
+
+    struct Entry
+    {
+      int node;
+      uint32_t mask;
+
+    } stack[64];
+    int top = 0;
+    RayPacket local;
+
+    stack[top++] = { 0, mask };
+    while (top > 0)
+    {
+      auto entry = stack[--top];
+      const auto& node = _nodes[entry.node];
+
+      RT_COUNT(nodesVisited, 1);
+      RT_COUNT(boxTests, bitCount(entry.mask));
+      if (packet.misses(node.bounds))
+        continue;
+
+      auto active = packet.intersect(node.bounds, hit, entry.mask);
+
+      if (active == 0)
+        continue;
+      if (node.count == 0)
+      {
+        stack[top++] = { node.offset, active };
+        stack[top++] = { entry.node + 1, active };
+        continue;
+      }
+      for (int i = node.offset, e = i + node.count; i < e; ++i)
+      {
+        const auto& instance = _instances[i];
+        auto m = active;
+
+        if (node.count > 1)
+        {
+          RT_COUNT(boxTests, bitCount(active));
+          m = packet.intersect(instance.bounds, hit, active);
+        }
+        if (m == 0)
+          continue;
+
+        // Transform the rays that hit the instance box
+        const auto& t = instance.worldToLocal;
+
+        for (int k = 0; k < RayPacket::size; ++k)
+          if ((m & (1u << k)) != 0)
+          {
+            auto o = t.transform(packet.rays[k].origin);
+            auto D = t.transformVector(packet.rays[k].direction);
+
+            local.rays[k] = { o, D };
+            local.d[k] = math::inverse(D.length()); // ||s||
+          }
+        local.update(m);
+
+        uint32_t bits = 0;
+
+        // A transform can break the coherence of the packet
+        if (local.coherent)
+          bits = instance.bvh->intersect(local, hit, m);
+        else
+          for (int k = 0; k < RayPacket::size; ++k)
+            if ((m & (1u << k)) != 0 &&
+              instance.bvh->intersect(local.rays[k], hit[k], local.d[k]))
+              bits |= 1u << k;
+        for (int k = 0; k < RayPacket::size; ++k)
+          if ((bits & (1u << k)) != 0)
+            hit[k].object = instance.primitive;
+      }
+    }
+
+    uint32_t result = 0;
+
+    for (int k = 0; k < RayPacket::size; ++k)
+      if ((mask & (1u << k)) != 0 && hit[k].object != nullptr)
+        result |= 1u << k;
+    return result;
+  }
+
+} // end namespace cg
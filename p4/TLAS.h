@@ -0,0 +1,123 @@
+//[]---------------------------------------------------------------[]
+//|                                                                 |
+//| Copyright (C) 2019 Orthrus Group.                               |
+//|                                                                 |
+//| This software is provided 'as-is', without any express or       |
+//| implied warranty. In no event will the authors be held liable   |
+//| for any damages arising from the use of this software.          |
+//|                                                                 |
+//| Permission is granted to anyone to use this software for any    |
+//| purpose, including commercial applications, and to alter it and |
+//| redistribute it freely, subject to the following restrictions:  |
+//|                                                                 |
+//| 1. The origin of this software must not be misrepresented; you  |
+//| must not claim that you wrote the original software. If you use |
+//| this software in a product, an acknowledgment in the product    |
+//| documentation would be appreciated but is not required.         |
+//|                                                                 |
+//| 2. Altered source versions must be plainly marked as such, and  |
+//| must not be misrepresented as being the original software.      |
+//|                                                                 |
+//| 3. This notice may not be removed or altered from any source    |
+//| distribution.                                                   |
+//|                                                                 |
+//[]---------------------------------------------------------------[]
+//
+// OVERVIEW: TLAS.h
+// ========
+// Class definition for top-level acceleration structure.
+//
+// Author(s): Paulo Pagliosa (and your name)
+// Last revision: 17/10/2026
+
+#ifndef __TLAS_h
+#define __TLAS_h
+
+#include "RayPacket.h"
+#include <vector>
+
+namespace cg
+{ // begin namespace cg
+
+class Primitive;
+class Scene;
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// TLAS: top-level BVH over the primitive instances of a scene
+// ====
+class TLAS: public SharedObject
+{
+public:
+  // Builds the TLAS over the visible primitives of scene with a BVH
+  TLAS(Scene& scene, int maxInstancesPerNode = 2);
+
+  auto numberOfInstances() const
+  {
+    return (int)_instances.size();
+  }
+
+  Bounds3f bounds() const;
+
+  // Updates the instance transforms and bounds and the node bounds
+  // bottom-up after objects of scene moved or their BVHs were refitted.
+  // Returns false if the TLAS should be rebuilt instead: when the set
+  // of visible instances changed or when the tree degraded too much
+  bool refit(Scene& scene, float maxCostRatio = 2);
+
+  bool intersect(const Ray& ray, Intersection& hit) const;
+
+  // Returns true if any instance is hit closer than ray.tMax
+  bool occluded(const Ray& ray) const;
+
+  // Intersects the rays in mask of a coherent packet of world rays
+  // (d must be 1). Returns the mask of the rays that hit an instance
+  uint32_t intersect(const RayPacket& packet,
+    Intersection hit[],
+    uint32_t mask) const;
+
+private:
+  struct Source
+  {
+    Primitive* primitive;
+    const BVH* bvh;
+
+  }; // Source
+
+  struct Instance
+  {
+    const Primitive* primitive;
+    const BVH* bvh;
+    mat4f worldToLocal;
+    Bounds3f bounds;
+    vec3f centroid;
+    int source; // index of the instance source
+
+  }; // Instance
+
+  struct Node
+  {
+    Bounds3f bounds;
+    int offset; // first instance (leaf) or second child (interior)
+    int count; // number of instances (0 for interior nodes)
+
+  }; // Node
+
+  std::vector<Source> _sources; // in scene order
+  std::vector<Instance> _instances;
+  std::vector<Node> _nodes;
+  int _maxInstancesPerNode;
+  float _buildCost{};
+
+  static void collectSources(Scene&, std::vector<Source>&);
+  static void setInstance(Instance&, const Source&, int);
+
+  int makeNode(int start, int end);
+  float computeCost() const;
+
+}; // TLAS
+
+} // end namespace cg
+
+#endif // __TLAS_h